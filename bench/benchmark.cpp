@@ -0,0 +1,339 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+// benchmark driver. runs the operators over a sweep of file sizes, buffer
+// sizes, key fields and data distributions, repeating each run, and writes
+// the results as JSON so that versions can be compared. built with the
+// sources of src, without main.cpp:
+// g++ -O3 -Isrc -o benchmark bench/benchmark.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#include "dbtproj.h"
+#include "fileOps.h"
+#include "opStats.h"
+
+// the operators benchmarked
+
+enum benchOperator {
+    OP_SORT,
+    OP_HASH_JOIN,
+    OP_MERGE_JOIN,
+    OP_DEDUP
+};
+
+const char *operatorNames[] = {"sort", "hashjoin", "mergejoin", "dedup"};
+
+// the workloads, generated with generateFile. for all but matched, both
+// files of a join follow the same distribution with different seeds
+// uniform: GEN_UNIFORM, like createFile
+// zipf: GEN_ZIPF with exponent --skew
+// sorted, reverse: GEN_SORTED and GEN_REVERSE_SORTED, sorted on every field
+// duplicates: GEN_DUPLICATES where each value appears about 10 times
+// matched: the files of generateJoinFiles, where a record of the second file
+// has a match with probability --selectivity
+
+enum benchDistribution {
+    DIST_UNIFORM,
+    DIST_ZIPF,
+    DIST_SORTED,
+    DIST_REVERSE,
+    DIST_DUPLICATES,
+    DIST_MATCHED
+};
+
+const char *distributionNames[] = {"uniform", "zipf", "sorted", "reverse", "duplicates", "matched"};
+
+keyDistribution generated[] = {GEN_UNIFORM, GEN_ZIPF, GEN_SORTED, GEN_REVERSE_SORTED, GEN_DUPLICATES};
+
+#define MAX_SWEEP 16
+
+// a list of values to sweep over
+
+typedef struct {
+    uint values[MAX_SWEEP];
+    uint count;
+} sweep;
+
+// the timing and counters of one configuration, over all its repetitions.
+// nres is the number of pairs of a join, the unique records of dedup and 0 for
+// sort
+
+typedef struct {
+    double *seconds;
+    uint nios;
+    uint nres;
+    opStats stats;
+} benchResult;
+
+// returns the seconds of the monotonic clock
+
+inline double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// generates the two files of a workload
+
+void createWorkload(char *infile1, char *infile2, uint size, benchDistribution dist, double skew, double selectivity, uint seed) {
+    if (dist == DIST_MATCHED) {
+        generateJoinFiles(infile1, size, infile2, size * 4 / 5, selectivity, seed);
+        return;
+    }
+    genSpec spec = defaultSpec(generated[dist], seed);
+    spec.skew = skew;
+    if (dist == DIST_DUPLICATES) {
+        spec.distinct = size * MAX_RECORDS_PER_BLOCK / 10 + 1;
+    }
+    generateFile(infile1, size, spec);
+    spec.seed = seed + 1;
+    generateFile(infile2, size * 4 / 5, spec);
+}
+
+// runs an operator once and returns the seconds it took
+
+double runOperator(benchOperator op, char *infile1, char *infile2, unsigned char field, block_t *buffer, uint nmem_blocks, char *outfile, uint *nres, uint *nios) {
+    uint nsorted_segs, npasses;
+    double start = now();
+    switch (op) {
+        case OP_SORT:
+            MergeSort(infile1, field, buffer, nmem_blocks, outfile, &nsorted_segs, &npasses, nios);
+            (*nres) = 0;
+            break;
+        case OP_HASH_JOIN:
+            HashJoin(infile1, infile2, field, buffer, nmem_blocks, outfile, nres, nios);
+            break;
+        case OP_MERGE_JOIN:
+            MergeJoin(infile1, infile2, field, buffer, nmem_blocks, outfile, nres, nios);
+            break;
+        default:
+            EliminateDuplicates(infile1, field, buffer, nmem_blocks, outfile, nres, nios);
+    }
+    return now() - start;
+}
+
+// returns the p-th percentile of the sorted seconds (nearest rank)
+
+inline double percentile(double *seconds, uint count, double p) {
+    uint rank = (uint) ceil(p / 100 * count);
+    if (rank == 0) {
+        rank = 1;
+    }
+    return seconds[rank - 1];
+}
+
+// parses a comma separated list of numbers, or of names from names, to list.
+// returns false if a value is not valid
+
+bool parseSweep(const char *arg, const char **names, uint nnames, sweep &list) {
+    list.count = 0;
+    char copy[256];
+    strncpy(copy, arg, sizeof (copy) - 1);
+    copy[sizeof (copy) - 1] = '\0';
+    for (char *value = strtok(copy, ","); value; value = strtok(NULL, ",")) {
+        if (list.count == MAX_SWEEP) {
+            return false;
+        }
+        if (!names) {
+            char *end;
+            list.values[list.count++] = strtoul(value, &end, 10);
+            if (*end != '\0') {
+                return false;
+            }
+            continue;
+        }
+        uint i = 0;
+        while (i < nnames && strcmp(names[i], value) != 0) {
+            i++;
+        }
+        if (i == nnames) {
+            return false;
+        }
+        list.values[list.count++] = i;
+    }
+    return list.count != 0;
+}
+
+void printUsage() {
+    printf("usage: benchmark [options]\n");
+    printf("  --ops sort,hashjoin,mergejoin,dedup  operators to run\n");
+    printf("  --sizes 76,760                       blocks of the first file (the second one has 4/5 of them)\n");
+    printf("  --mem 10,50                          values of nmem_blocks\n");
+    printf("  --fields 1,2                         key fields (0 recid, 1 num, 2 str, 3 num and str)\n");
+    printf("  --dists uniform,zipf,sorted,reverse,duplicates,matched\n");
+    printf("  --skew 0.5                           exponent of zipf\n");
+    printf("  --selectivity 0.5                    probability that a record of the second file has a match, for matched\n");
+    printf("  --reps 3                             repetitions of each configuration\n");
+    printf("  --seed 1                             seed of the generated files\n");
+    printf("  --label name                         label of the results, eg the version benchmarked\n");
+    printf("  --out benchmark.json                 file the results are written to\n");
+}
+
+/*
+ * out: the results file
+ * first: true if it is the first result written
+ * the rest: the configuration and its result
+ *
+ * writes a result as a JSON object of the results array. the latencies are the
+ * percentiles of the repetitions, and the throughput is computed from the
+ * median. the stats are those of the last repetition
+ */
+void writeResult(FILE *out, bool first, benchOperator op, benchDistribution dist, uint size, uint records, uint nmem_blocks, uint field, uint reps, benchResult &result) {
+    double median = percentile(result.seconds, reps, 50);
+    double bytes = (double) size * sizeof (block_t);
+    fprintf(out, "%s\n  {\"operator\": \"%s\", \"distribution\": \"%s\", \"blocks\": %u, \"records\": %u, ", first ? "" : ",", operatorNames[op], distributionNames[dist], size, records);
+    fprintf(out, "\"nmem_blocks\": %u, \"field\": %u, \"repetitions\": %u, \"nios\": %u, \"nres\": %u, ", nmem_blocks, field, reps, result.nios, result.nres);
+    fprintf(out, "\"seconds\": {\"min\": %.6f, \"p50\": %.6f, \"p90\": %.6f, \"p99\": %.6f, \"max\": %.6f}, ", result.seconds[0], median, percentile(result.seconds, reps, 90), percentile(result.seconds, reps, 99), result.seconds[reps - 1]);
+    fprintf(out, "\"records_per_second\": %.0f, \"mb_per_second\": %.3f, ", median > 0 ? records / median : 0, median > 0 ? bytes / median / 1e6 : 0);
+    fprintf(out, "\"stats\": ");
+    writeStatsJson(result.stats, out);
+    fprintf(out, "  }");
+}
+
+int main(int argc, char** argv) {
+    const char *sizesArg = "76,760";
+    const char *memArg = "10,50";
+    const char *fieldsArg = "1,2";
+    const char *opsArg = "sort,hashjoin,mergejoin,dedup";
+    const char *distsArg = "uniform,zipf,sorted,reverse,duplicates,matched";
+    const char *label = "";
+    char *outName = (char*) "benchmark.json";
+    uint reps = 3, seed = 1;
+    double skew = 0.5, selectivity = 0.5;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc || strncmp(argv[i], "--", 2) != 0) {
+            printUsage();
+            return 1;
+        }
+        const char *option = argv[i] + 2;
+        char *value = argv[++i];
+        if (strcmp(option, "sizes") == 0) {
+            sizesArg = value;
+        } else if (strcmp(option, "mem") == 0) {
+            memArg = value;
+        } else if (strcmp(option, "fields") == 0) {
+            fieldsArg = value;
+        } else if (strcmp(option, "ops") == 0) {
+            opsArg = value;
+        } else if (strcmp(option, "dists") == 0) {
+            distsArg = value;
+        } else if (strcmp(option, "reps") == 0) {
+            reps = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "seed") == 0) {
+            seed = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "skew") == 0) {
+            skew = strtod(value, NULL);
+        } else if (strcmp(option, "selectivity") == 0) {
+            selectivity = strtod(value, NULL);
+        } else if (strcmp(option, "label") == 0) {
+            label = value;
+        } else if (strcmp(option, "out") == 0) {
+            outName = value;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    sweep sizes, mems, fields, ops, dists;
+    if (!parseSweep(sizesArg, NULL, 0, sizes) || !parseSweep(memArg, NULL, 0, mems) || !parseSweep(fieldsArg, NULL, 0, fields)
+            || !parseSweep(opsArg, operatorNames, 4, ops) || !parseSweep(distsArg, distributionNames, 6, dists) || reps == 0) {
+        printUsage();
+        return 1;
+    }
+    for (uint m = 0; m < mems.count; m++) {
+        if (mems.values[m] < 3) {
+            printf("At least 3 blocks are required.\n");
+            return 1;
+        }
+    }
+
+    FILE *out = fopen(outName, "w");
+    if (!out) {
+        printf("Cannot open %s.\n", outName);
+        return 1;
+    }
+    fprintf(out, "{\"label\": \"%s\", \"results\": [", label);
+
+    char infile1[] = "bench1.bin";
+    char infile2[] = "bench2.bin";
+    char outfile[] = "bench_out.bin";
+    uint maxMem = 0;
+    for (uint m = 0; m < mems.count; m++) {
+        maxMem = std::max(maxMem, mems.values[m]);
+    }
+    block_t *buffer = (block_t*) malloc(maxMem * sizeof (block_t));
+    benchResult result;
+    result.seconds = (double*) malloc(reps * sizeof (double));
+    bool first = true;
+
+    printf("%-10s %-10s %7s %5s %5s %9s %9s %9s %9s %12s %9s\n", "operator", "dist", "blocks", "mem", "field", "nios", "nres", "p50 (s)", "p99 (s)", "records/s", "MB/s");
+    // the files are generated once for each distribution and size. records
+    // counts the records of the blocks, valid or not
+    for (uint d = 0; d < dists.count; d++) {
+        benchDistribution dist = (benchDistribution) dists.values[d];
+        for (uint s = 0; s < sizes.count; s++) {
+            uint size = sizes.values[s];
+            createWorkload(infile1, infile2, size, dist, skew, selectivity, seed);
+            for (uint o = 0; o < ops.count; o++) {
+                benchOperator op = (benchOperator) ops.values[o];
+                bool isJoin = op == OP_HASH_JOIN || op == OP_MERGE_JOIN;
+                uint blocks = isJoin ? size + size * 4 / 5 : size;
+                uint records = blocks * MAX_RECORDS_PER_BLOCK;
+                for (uint m = 0; m < mems.count; m++) {
+                    for (uint f = 0; f < fields.count; f++) {
+                        for (uint r = 0; r < reps; r++) {
+                            // only the stats of the last repetition are kept
+                            if (r != 0) {
+                                destroyStats(result.stats);
+                            }
+                            startStats(result.stats);
+                            result.seconds[r] = runOperator(op, infile1, infile2, fields.values[f], buffer, mems.values[m], outfile, &result.nres, &result.nios);
+                            stopStats();
+                        }
+                        std::sort(result.seconds, result.seconds + reps);
+                        writeResult(out, first, op, dist, blocks, records, mems.values[m], fields.values[f], reps, result);
+                        first = false;
+                        double median = percentile(result.seconds, reps, 50);
+                        printf("%-10s %-10s %7u %5u %5u %9u %9u %9.4f %9.4f %12.0f %9.2f\n", operatorNames[op], distributionNames[dist], blocks, mems.values[m], fields.values[f],
+                                result.nios, result.nres, median, percentile(result.seconds, reps, 99), median > 0 ? records / median : 0, median > 0 ? blocks * sizeof (block_t) / median / 1e6 : 0);
+                        destroyStats(result.stats);
+                    }
+                }
+            }
+        }
+    }
+    fprintf(out, "]}\n");
+    fclose(out);
+    remove(infile1);
+    remove(infile2);
+    remove(outfile);
+    free(buffer);
+    free(result.seconds);
+    return 0;
+}
@@ -0,0 +1,265 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+// microbenchmark of the records moved by the merge of MergeSort. it merges
+// sorted segments held in memory, once the way merge did before the view
+// API, keeping the current minimum as a copy, and once the way it does now,
+// keeping a pointer to it in the buffer. for each it reports the bytes of
+// records copied per output record and the time taken. built with the
+// sources of src, without main.cpp:
+// g++ -O3 -Isrc -o recordCopies bench/recordCopies.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dbtproj.h"
+#include "fileOps.h"
+#include "bufferOps.h"
+#include "recordOps.h"
+#include "recordPtr.h"
+#include "sortBuffer.h"
+
+// returns the seconds of the monotonic clock
+
+inline double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a sorted segment of the buffer: the records from next up to, but not
+// including, end
+
+typedef struct {
+    recordPtr next;
+    recordPtr end;
+} segment;
+
+/*
+ * buffer: the blocks of the segments
+ * segs: the segments, rewound to their start
+ * nsegs: number of segments
+ * out: the output block, emptied each time it fills
+ * copied: bytes of records copied, increased
+ *
+ * merges the segments as merge did before: the current minimum is a record_t
+ * copied out of the buffer each time a smaller candidate is found, and copied
+ * once more into the output block. returns the records merged
+ */
+template<class Key>
+uint mergeByValue(block_t *buffer, segment *segs, uint nsegs, block_t *out, uint64_t *copied) {
+    uint merged = 0;
+    while (true) {
+        uint i = 0;
+        while (i < nsegs && segs[i].next == segs[i].end) {
+            i++;
+        }
+        if (i == nsegs) {
+            break;
+        }
+        record_t minRec = getRecord(buffer, segs[i].next);
+        (*copied) += sizeof (record_t);
+        uint minSeg = i;
+        for (uint j = i + 1; j < nsegs; j++) {
+            if (segs[j].next != segs[j].end && Key::compare(getRecord(buffer, segs[j].next), minRec) < 0) {
+                minRec = getRecord(buffer, segs[j].next);
+                (*copied) += sizeof (record_t);
+                minSeg = j;
+            }
+        }
+        (*out).entries[(*out).nreserved++] = minRec;
+        (*copied) += sizeof (record_t);
+        if ((*out).nreserved == MAX_RECORDS_PER_BLOCK) {
+            emptyBlock(out);
+        }
+        incr(segs[minSeg].next);
+        merged += 1;
+    }
+    return merged;
+}
+
+/*
+ * the same arguments as mergeByValue
+ *
+ * merges the segments as merge does now: the current minimum is a pointer to
+ * the record in the buffer, so the only copy is the one into the output block
+ */
+template<class Key>
+uint mergeInPlace(block_t *buffer, segment *segs, uint nsegs, block_t *out, uint64_t *copied) {
+    uint merged = 0;
+    while (true) {
+        uint i = 0;
+        while (i < nsegs && segs[i].next == segs[i].end) {
+            i++;
+        }
+        if (i == nsegs) {
+            break;
+        }
+        const record_t *minRec = &getRecord(buffer, segs[i].next);
+        uint minSeg = i;
+        for (uint j = i + 1; j < nsegs; j++) {
+            if (segs[j].next != segs[j].end && Key::compare(getRecord(buffer, segs[j].next), *minRec) < 0) {
+                minRec = &getRecord(buffer, segs[j].next);
+                minSeg = j;
+            }
+        }
+        (*out).entries[(*out).nreserved++] = *minRec;
+        (*copied) += sizeof (record_t);
+        if ((*out).nreserved == MAX_RECORDS_PER_BLOCK) {
+            emptyBlock(out);
+        }
+        incr(segs[minSeg].next);
+        merged += 1;
+    }
+    return merged;
+}
+
+// the two merges of a key field
+
+typedef uint (*mergeFunction)(block_t*, segment*, uint, block_t*, uint64_t*);
+
+template<class Key>
+void mergesOf(mergeFunction &byValue, mergeFunction &inPlace) {
+    byValue = mergeByValue<Key>;
+    inPlace = mergeInPlace<Key>;
+}
+
+/*
+ * buffer: the blocks of the segments, nsegs * segBlocks of them
+ * segs: filled with the segments
+ *
+ * sorts each group of segBlocks blocks on field. sortBuffer gathers the valid
+ * records at the start of the group, so each segment ends at the first
+ * invalid one
+ */
+void sortSegments(block_t *buffer, segment *segs, uint nsegs, uint segBlocks, unsigned char field) {
+    for (uint s = 0; s < nsegs; s++) {
+        block_t *seg = buffer + s * segBlocks;
+        sortBuffer(seg, segBlocks, field);
+        uint offset = s * segBlocks * MAX_RECORDS_PER_BLOCK;
+        uint nvalid = 0;
+        while (nvalid < segBlocks * MAX_RECORDS_PER_BLOCK && seg[nvalid / MAX_RECORDS_PER_BLOCK].valid
+                && seg[nvalid / MAX_RECORDS_PER_BLOCK].entries[nvalid % MAX_RECORDS_PER_BLOCK].valid) {
+            nvalid++;
+        }
+        segs[s].next = newPtr(offset);
+        segs[s].end = newPtr(offset + nvalid);
+    }
+}
+
+void printUsage() {
+    printf("usage: recordCopies [options]\n");
+    printf("  --ways 99      segments merged at once, like nmem_blocks - 1\n");
+    printf("  --blocks 40    blocks of each segment\n");
+    printf("  --reps 5       repetitions of each merge, the fastest is reported\n");
+    printf("  --seed 1       seed of the generated records\n");
+}
+
+int main(int argc, char** argv) {
+    uint ways = 99, segBlocks = 40, reps = 5, seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc || strncmp(argv[i], "--", 2) != 0) {
+            printUsage();
+            return 1;
+        }
+        const char *option = argv[i] + 2;
+        char *value = argv[++i];
+        if (strcmp(option, "ways") == 0) {
+            ways = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "blocks") == 0) {
+            segBlocks = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "reps") == 0) {
+            reps = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "seed") == 0) {
+            seed = strtoul(value, NULL, 10);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (ways < 2 || segBlocks == 0 || reps == 0) {
+        printUsage();
+        return 1;
+    }
+
+    // the records are generated once and sorted again on each field
+    char infile[] = "recordCopies.bin";
+    uint size = ways * segBlocks;
+    generateFile(infile, size, defaultSpec(GEN_UNIFORM, seed));
+    block_t *records = (block_t*) malloc(size * sizeof (block_t));
+    block_t *buffer = (block_t*) malloc(size * sizeof (block_t));
+    segment *segs = (segment*) malloc(ways * sizeof (segment));
+    segment *rewound = (segment*) malloc(ways * sizeof (segment));
+    block_t out;
+    readBlocks(infile, records, size);
+    remove(infile);
+
+    printf("%u segments of %u blocks, %zu bytes per record\n", ways, segBlocks, sizeof (record_t));
+    printf("%-6s %-9s %10s %14s %12s\n", "field", "merge", "records", "bytes/record", "seconds");
+    for (unsigned char field = 0; field < 4; field++) {
+        mergeFunction byValue, inPlace;
+        switch (field) {
+            case 0:
+                mergesOf<RecidKey>(byValue, inPlace);
+                break;
+            case 1:
+                mergesOf<NumKey>(byValue, inPlace);
+                break;
+            case 2:
+                mergesOf<StrKey>(byValue, inPlace);
+                break;
+            default:
+                mergesOf<NumStrKey>(byValue, inPlace);
+                break;
+        }
+        memcpy(buffer, records, size * sizeof (block_t));
+        sortSegments(buffer, rewound, ways, segBlocks, field);
+
+        const char *names[] = {"by value", "in place"};
+        mergeFunction merges[] = {byValue, inPlace};
+        for (uint m = 0; m < 2; m++) {
+            double best = 0;
+            uint64_t copied = 0;
+            uint merged = 0;
+            for (uint r = 0; r < reps; r++) {
+                memcpy(segs, rewound, ways * sizeof (segment));
+                emptyBlock(&out);
+                copied = 0;
+                double start = now();
+                merged = merges[m](buffer, segs, ways, &out, &copied);
+                double seconds = now() - start;
+                if (r == 0 || seconds < best) {
+                    best = seconds;
+                }
+            }
+            printf("%-6u %-9s %10u %14.1f %12.6f\n", field, names[m], merged, merged ? (double) copied / merged : 0, best);
+        }
+    }
+
+    free(records);
+    free(buffer);
+    free(segs);
+    free(rewound);
+    return 0;
+}
@@ -0,0 +1,181 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+// microbenchmark of the kernels of strKernels. each kernel the cpu supports
+// is selected with setStrKernel and times compareStr over pairs of str fields
+// and hashStr over str fields, on random strings, which mostly differ in
+// their first bytes, and on strings of STR_LENGTH - 1 bytes that only differ
+// in their last bytes. the checksums of the results are printed too, and must
+// be the same for all the kernels. built with the sources of src, without
+// main.cpp:
+// g++ -O3 -Isrc -o strKernels bench/strKernels.cpp $(ls src/*.cpp | grep -v main.cpp) -lpthread
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dbtproj.h"
+#include "fileOps.h"
+#include "bufferOps.h"
+#include "strKernels.h"
+
+// returns the seconds of the monotonic clock
+
+inline double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// compares each record with the next one and returns a checksum of the signs
+
+uint compareAll(const record_t *records, uint nrecords) {
+    uint sum = 0;
+    for (uint i = 0; i + 1 < nrecords; i++) {
+        int cmp = compareStr(records[i].str, records[i + 1].str);
+        sum = sum * 3 + (cmp > 0) - (cmp < 0);
+    }
+    return sum;
+}
+
+// hashes each record and returns a checksum of the hashes
+
+uint hashAll(const record_t *records, uint nrecords) {
+    uint sum = 0;
+    for (uint i = 0; i < nrecords; i++) {
+        sum = sum * 31 + hashStr(records[i].str);
+    }
+    return sum;
+}
+
+/*
+ * records: the records the kernels run over
+ * kernel: the kernel to select
+ * reps: repetitions, the fastest is reported
+ *
+ * times compareStr and hashStr with kernel and prints a line with the
+ * nanoseconds per call and the checksums
+ */
+void runKernel(const char *workload, const record_t *records, uint nrecords, strKernel kernel, uint reps) {
+    const char *kernelNames[] = {"scalar", "sse4.2", "avx2"};
+    if (setStrKernel(kernel) != kernel) {
+        printf("%-8s %-8s %s\n", workload, kernelNames[kernel], "not supported by the cpu");
+        return;
+    }
+    double compareTime = 0, hashTime = 0;
+    uint compareSum = 0, hashSum = 0;
+    for (uint r = 0; r < reps; r++) {
+        double start = now();
+        compareSum = compareAll(records, nrecords);
+        double middle = now();
+        hashSum = hashAll(records, nrecords);
+        double end = now();
+        if (r == 0 || middle - start < compareTime) {
+            compareTime = middle - start;
+        }
+        if (r == 0 || end - middle < hashTime) {
+            hashTime = end - middle;
+        }
+    }
+    printf("%-8s %-8s %14.2f %14.2f %12x %12x\n", workload, kernelNames[kernel],
+            compareTime * 1e9 / (nrecords - 1), hashTime * 1e9 / nrecords, compareSum, hashSum);
+}
+
+void printUsage() {
+    printf("usage: strKernels [options]\n");
+    printf("  --blocks 1000  blocks of records generated\n");
+    printf("  --reps 5       repetitions of each kernel, the fastest is reported\n");
+    printf("  --seed 1       seed of the generated records\n");
+}
+
+int main(int argc, char** argv) {
+    uint size = 1000, reps = 5, seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc || strncmp(argv[i], "--", 2) != 0) {
+            printUsage();
+            return 1;
+        }
+        const char *option = argv[i] + 2;
+        char *value = argv[++i];
+        if (strcmp(option, "blocks") == 0) {
+            size = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "reps") == 0) {
+            reps = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "seed") == 0) {
+            seed = strtoul(value, NULL, 10);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (size == 0 || reps == 0) {
+        printUsage();
+        return 1;
+    }
+
+    // the valid records of a generated file are gathered in an array, as the
+    // random workload. the prefix workload gives them all the same first
+    // STR_LENGTH - 5 bytes, and the last 4 come from their random string
+    char infile[] = "strKernels.bin";
+    generateFile(infile, size, defaultSpec(GEN_UNIFORM, seed));
+    block_t *buffer = (block_t*) malloc(size * sizeof (block_t));
+    readBlocks(infile, buffer, size);
+    remove(infile);
+    record_t *random = (record_t*) malloc(size * MAX_RECORDS_PER_BLOCK * sizeof (record_t));
+    record_t *prefix = (record_t*) malloc(size * MAX_RECORDS_PER_BLOCK * sizeof (record_t));
+    uint nrecords = 0;
+    for (uint b = 0; b < size; b++) {
+        for (int i = 0; i < MAX_RECORDS_PER_BLOCK; i++) {
+            if (buffer[b].entries[i].valid) {
+                random[nrecords] = buffer[b].entries[i];
+                prefix[nrecords] = buffer[b].entries[i];
+                memset(prefix[nrecords].str, 'a', STR_LENGTH - 5);
+                for (int j = 0; j < 4; j++) {
+                    char c = random[nrecords].str[j];
+                    prefix[nrecords].str[STR_LENGTH - 5 + j] = c ? c : 'a';
+                }
+                prefix[nrecords].str[STR_LENGTH - 1] = '\0';
+                nrecords++;
+            }
+        }
+    }
+    free(buffer);
+    if (nrecords < 2) {
+        printf("Too few records.\n");
+        return 1;
+    }
+
+    printf("%u records\n", nrecords);
+    printf("%-8s %-8s %14s %14s %12s %12s\n", "strings", "kernel", "compare (ns)", "hash (ns)", "compare sum", "hash sum");
+    strKernel kernels[] = {STR_SCALAR, STR_SSE42, STR_AVX2};
+    for (uint k = 0; k < 3; k++) {
+        runKernel("random", random, nrecords, kernels[k], reps);
+    }
+    for (uint k = 0; k < 3; k++) {
+        runKernel("prefix", prefix, nrecords, kernels[k], reps);
+    }
+
+    free(random);
+    free(prefix);
+    return 0;
+}
@@ -0,0 +1,526 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h> 
+#include <unistd.h>
+
+#include "dbtproj.h"
+#include "recordOps.h"
+#include "bufferOps.h"
+#include "sortBuffer.h"
+#include "blockBatch.h"
+#include "blockScan.h"
+#include "blockSink.h"
+#include "opStats.h"
+#include "tempSpace.h"
+
+// aggregate policies. each group is kept as one record, the partial group,
+// whose value slot holds the aggregate of the records seen so far. start
+// returns the value of a group of one record and combine the value of two
+// groups put together, so that partial groups can be combined again later
+
+struct CountAgg {
+
+    static inline uint start(const record_t &) {
+        return 1;
+    }
+
+    static inline uint combine(uint value1, uint value2) {
+        return value1 + value2;
+    }
+};
+
+struct SumAgg {
+
+    static inline uint start(const record_t &rec) {
+        return rec.num;
+    }
+
+    static inline uint combine(uint value1, uint value2) {
+        return value1 + value2;
+    }
+};
+
+struct MinAgg {
+
+    static inline uint start(const record_t &rec) {
+        return rec.num;
+    }
+
+    static inline uint combine(uint value1, uint value2) {
+        return value1 < value2 ? value1 : value2;
+    }
+};
+
+struct MaxAgg {
+
+    static inline uint start(const record_t &rec) {
+        return rec.num;
+    }
+
+    static inline uint combine(uint value1, uint value2) {
+        return value1 > value2 ? value1 : value2;
+    }
+};
+
+// the value of a partial group is kept on recid, or on num if the records are
+// grouped on recid, so that the field values of the group are not changed
+
+template <class Key>
+inline uint getValue(const record_t &rec) {
+    return Key::field == 0 ? rec.num : rec.recid;
+}
+
+template <class Key>
+inline void setValue(record_t &rec, uint value) {
+    if (Key::field == 0) {
+        rec.num = value;
+    } else {
+        rec.recid = value;
+    }
+}
+
+// state of the in-memory aggregation. the partial groups are kept one after
+// the other in the first memSize blocks of the buffer and are found through a
+// hash index with one bucket per record the blocks can hold
+
+typedef struct {
+    block_t *buffer;
+    uint memSize;
+    uint seed;
+    uint hashSize;
+    linkedRecordPtr **hashIndex;
+    // the elements of the hash index, one per group, so that they are not
+    // allocated per group and are dropped at once when the groups are
+    linkedRecordPtr *elements;
+    uint ngroups;
+} groupTable;
+
+void initGroups(groupTable &table, block_t *buffer, uint memSize, char *infile) {
+    table.buffer = buffer;
+    table.memSize = memSize;
+    table.seed = hashSeed(infile);
+    table.hashSize = memSize * MAX_RECORDS_PER_BLOCK;
+    table.hashIndex = (linkedRecordPtr**) malloc(table.hashSize * sizeof (linkedRecordPtr*));
+    table.elements = (linkedRecordPtr*) malloc(table.hashSize * sizeof (linkedRecordPtr));
+}
+
+// drops all the groups of table
+
+void clearGroups(groupTable &table) {
+    emptyBuffer(table.buffer, table.memSize);
+    for (uint i = 0; i < table.hashSize; i++) {
+        table.hashIndex[i] = NULL;
+    }
+    table.ngroups = 0;
+}
+
+void destroyGroups(groupTable &table) {
+    free(table.hashIndex);
+    free(table.elements);
+}
+
+// adds record to its group of table. returns false if the record starts a new
+// group and there is no room left for it
+
+template <class Key, class Agg>
+bool addRecord(groupTable &table, const record_t &record) {
+    uint index = Key::hash(table.seed, record, table.hashSize);
+    for (linkedRecordPtr *element = table.hashIndex[index]; element; element = element->next) {
+        record_t &group = table.buffer[element->ptr.block].entries[element->ptr.record];
+        if (Key::compare(record, group) == 0) {
+            setValue<Key>(group, Agg::combine(getValue<Key>(group), Agg::start(record)));
+            return true;
+        }
+    }
+    if (table.ngroups == table.hashSize) {
+        return false;
+    }
+    recordPtr ptr = newPtr(table.ngroups);
+    uint value = Agg::start(record);
+    setRecord(table.buffer, record, ptr);
+    setValue<Key>(table.buffer[ptr.block].entries[ptr.record], value);
+    table.buffer[ptr.block].nreserved += 1;
+
+    linkedRecordPtr *element = table.elements + table.ngroups;
+    element->ptr = ptr;
+    element->next = table.hashIndex[index];
+    table.hashIndex[index] = element;
+    table.ngroups += 1;
+    return true;
+}
+
+// returns the number of blocks used by the groups of table
+
+inline uint groupBlocks(groupTable &table) {
+    return (table.ngroups + MAX_RECORDS_PER_BLOCK - 1) / MAX_RECORDS_PER_BLOCK;
+}
+
+/*
+ * infile: input filename
+ * buffer: the buffer that is used
+ * memSize: number of buffer blocks used for the groups. the next one is used for input
+ * sink: receives the groups, if they all fit on the buffer
+ * runFile: the file where the runs are written, if they don't
+ * runs: set to the number of runs written
+ * lastRunSize: set to the size in blocks of the last run
+ * ngroups: number of groups
+ * nios: number of ios
+ *
+ * scans infile and aggregates its records on the groups of the buffer, like
+ * hashElimination. if all the groups fit, they are passed to sink as they are.
+ * otherwise, whenever the buffer is full of groups, they are sorted and written
+ * to runFile as one run of memSize blocks, so that the runs hold partial groups
+ * that are merged on the next passes. returns true if the groups fit
+ */
+template <class Key, class Agg>
+bool hashAggregation(char *infile, block_t *buffer, uint memSize, blockSink *sink, char *runFile, uint &runs, uint &lastRunSize, uint *ngroups, uint *nios) {
+    groupTable table;
+    initGroups(table, buffer, memSize, infile);
+    clearGroups(table);
+    runs = 0;
+    int output = -1;
+
+    blockScan scan;
+    if (openScan(scan, infile)) {
+        for (uint b = 0; b < scan.size; b++) {
+            block_t *block = nextBlock(scan, buffer + memSize, nios);
+            if (!(*block).valid) {
+                continue;
+            }
+            recordMask valid = validRecords(block);
+            for (int r = nextValid(valid); r >= 0; r = nextValid(valid)) {
+                const record_t &record = (*block).entries[r];
+                if (addRecord<Key, Agg>(table, record)) {
+                    continue;
+                }
+                // the buffer is full of groups, so they are written as a run
+                if (output < 0) {
+                    output = openTemp(runFile, O_WRONLY | O_CREAT | O_TRUNC, true);
+                }
+                sortBuffer<Key>(buffer, memSize);
+                (*nios) += writeBlocks(output, buffer, memSize);
+                runs += 1;
+                clearGroups(table);
+                addRecord<Key, Agg>(table, record);
+            }
+        }
+        closeScan(scan);
+    }
+
+    uint size = groupBlocks(table);
+    if (output < 0) {
+        // all the groups fit, so they are output in the order they were found
+        (*ngroups) = table.ngroups;
+        for (uint b = 0; b < size; b++) {
+            buffer[b].blockid = b;
+            (*nios) += putBlock(sink, buffer + b);
+        }
+    } else {
+        // the groups left are the last run. there is at least one, the one
+        // that did not fit when the previous run was written
+        sortBuffer<Key>(buffer, size);
+        (*nios) += writeBlocks(output, buffer, size);
+        runs += 1;
+        lastRunSize = size;
+        closeTemp(output);
+    }
+    destroyGroups(table);
+    return output < 0;
+}
+
+// the following code is similar to mergeElimination from EliminateDuplicates.cpp
+// the difference is that equal records are partial groups that are combined
+// into one, on every pass and not only on the last one. the group being
+// combined is kept aside and written to the output once all its records have
+// been merged
+
+template <class Key, class Agg>
+uint mergeAggregation(int &input, blockSink *output, block_t *buffer, uint memSize, uint segsToMerge, uint *blocksLeft, uint segmentSize, uint firstSegOffset, bool lastPass, bool lastMergeOfPass, uint *ngroups) {
+    uint ios = 0;
+    block_t *bufferOut = buffer + memSize;
+    uint blocksWritten = 0;
+    uint sizeOfLastSeg;
+    if (lastMergeOfPass) {
+        sizeOfLastSeg = blocksLeft[segsToMerge - 1] + 1;
+    }
+    record_t group;
+    bool hasGroup = false;
+
+    recordPtr *nextRecord = (recordPtr*) malloc(segsToMerge * sizeof (recordPtr));
+    for (uint i = 0; i < segsToMerge; i++) {
+        nextRecord[i].block = i;
+        nextRecord[i].record = 0;
+    }
+    emptyBlock(bufferOut);
+    (*bufferOut).blockid = 0;
+
+    uint segsToMergeCopy = segsToMerge;
+    while (segsToMergeCopy != 0) {
+        uint i;
+        for (i = 0; i < segsToMerge; i++) {
+            if (buffer[i].valid) {
+                break;
+            }
+        }
+        const record_t *minRec = &getRecord(buffer, nextRecord[i]);
+        uint minBuffIndex = i;
+
+        for (uint j = i + 1; j < segsToMerge; j++) {
+            if (buffer[j].valid && Key::compare(getRecord(buffer, nextRecord[j]), *minRec) < 0) {
+                minRec = &getRecord(buffer, nextRecord[j]);
+                minBuffIndex = j;
+            }
+        }
+
+        if (hasGroup && Key::compare(group, *minRec) == 0) {
+            setValue<Key>(group, Agg::combine(getValue<Key>(group), getValue<Key>(*minRec)));
+        } else {
+            // the previous group is over, so it is written to the output
+            if (hasGroup) {
+                (*bufferOut).entries[(*bufferOut).nreserved++] = group;
+                if (lastPass) {
+                    (*ngroups) += 1;
+                }
+                if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
+                    ios += putBlock(output, bufferOut);
+                    (*bufferOut).blockid += 1;
+                    blocksWritten += 1;
+                    emptyBlock(bufferOut);
+                }
+            }
+            group = *minRec;
+            hasGroup = true;
+        }
+
+        incr(nextRecord[minBuffIndex]);
+
+        if (nextRecord[minBuffIndex].record == 0) {
+            nextRecord[minBuffIndex].block -= 1;
+            if (blocksLeft[minBuffIndex] > 0) {
+                uint blockOffset;
+                if (lastMergeOfPass && minBuffIndex == segsToMerge - 1) {
+                    blockOffset = firstSegOffset + segmentSize * minBuffIndex + sizeOfLastSeg - blocksLeft[minBuffIndex];
+                } else {
+                    blockOffset = firstSegOffset + segmentSize * minBuffIndex + segmentSize - blocksLeft[minBuffIndex];
+                }
+                ios += preadBlocks(input, buffer + minBuffIndex, blockOffset, 1);
+                blocksLeft[minBuffIndex] -= 1;
+                if (!buffer[minBuffIndex].valid) {
+                    segsToMergeCopy -= 1;
+                }
+            } else {
+                buffer[minBuffIndex].valid = false;
+                segsToMergeCopy -= 1;
+            }
+        } else {
+            if (!getRecord(buffer, nextRecord[minBuffIndex]).valid) {
+                buffer[minBuffIndex].valid = false;
+                segsToMergeCopy -= 1;
+            }
+        }
+    }
+    free(nextRecord);
+
+    if (hasGroup) {
+        (*bufferOut).entries[(*bufferOut).nreserved++] = group;
+        if (lastPass) {
+            (*ngroups) += 1;
+        }
+    }
+    if ((*bufferOut).nreserved != 0) {
+        ios += putBlock(output, bufferOut);
+        (*bufferOut).blockid += 1;
+        blocksWritten += 1;
+    }
+    if (!lastPass) {
+        uint mergedSize = segmentSize * segsToMerge;
+        if (lastMergeOfPass) {
+            mergedSize = segmentSize * (segsToMerge - 1) + sizeOfLastSeg;
+        }
+        for (uint i = blocksWritten; i < mergedSize; i++) {
+            ios += putBlock(output, buffer);
+        }
+    }
+    return ios;
+}
+
+// groups the records of infile on the field of the key policy and aggregates
+// each group with the aggregate policy
+
+template <class Key, class Agg>
+void aggregate(char *infile, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *ngroups, unsigned int *nios) {
+
+    emptyBuffer(buffer, nmem_blocks);
+    uint memSize = nmem_blocks - 1;
+    *ngroups = 0;
+    *nios = 0;
+
+    tempSpace space;
+    if (!openSpace(space)) {
+        return;
+    }
+    char *tmpName1 = tempPath(space, "ag1");
+    char *tmpName2 = tempPath(space, "ag2");
+    char *tmpFile1 = tmpName1;
+    char *tmpFile2 = tmpName2;
+
+    // the groups are first aggregated in memory. if they fit, they are already
+    // output. otherwise runs of partial groups are merged, like the sorted
+    // segments of EliminateDuplicates, each run being memSize blocks long
+    uint nSortedSegs;
+    uint lastSegmentSize;
+    beginPhase("hashing", 1);
+    if (hashAggregation<Key, Agg>(infile, buffer, memSize, sink, tmpFile1, nSortedSegs, lastSegmentSize, ngroups, nios)) {
+        free(tmpName1);
+        free(tmpName2);
+        closeSpace(space);
+        endPhase();
+        return;
+    }
+
+    uint segmentSize = memSize;
+    int input, output;
+    emptyBuffer(buffer, nmem_blocks);
+    bool lastPass = false;
+    uint pass = 1;
+    while (!lastPass) {
+        lastPass = nSortedSegs <= memSize;
+        pass += 1;
+        beginPhase("merge", pass);
+        input = openTemp(tmpFile1, O_RDONLY, false);
+        blockSink tmpSink;
+        blockSink *passSink = sink;
+        if (!lastPass) {
+            output = openTemp(tmpFile2, O_WRONLY | O_CREAT | O_TRUNC, true);
+            tmpSink = fileSink(output);
+            passSink = &tmpSink;
+        }
+
+        uint newSortedSegs = 0;
+        uint fullMerges = nSortedSegs / memSize;
+        uint lastMergeSegs = nSortedSegs % memSize;
+        uint *blocksLeft = (uint*) malloc(memSize * sizeof (uint));
+        uint segsToMerge = memSize;
+        bool lastMerge = false;
+
+        for (uint mergeCounter = 0; mergeCounter <= fullMerges; mergeCounter++) {
+            uint firstSegOffset = mergeCounter * memSize * segmentSize;
+
+            if (mergeCounter == fullMerges - 1 && lastMergeSegs == 0) {
+                lastMerge = true;
+            } else if (mergeCounter == fullMerges) {
+                if (lastMergeSegs != 0) {
+                    segsToMerge = lastMergeSegs;
+                    lastMerge = true;
+                } else {
+                    break;
+                }
+            }
+
+            for (uint i = 0; i < segsToMerge; i++) {
+                (*nios) += queueRead(input, buffer + i, (firstSegOffset + i * segmentSize), 1);
+                blocksLeft[i] = segmentSize - 1;
+            }
+            waitBlocks();
+
+            if (lastMerge) {
+                blocksLeft[segsToMerge - 1] = lastSegmentSize - 1;
+            }
+
+            (*nios) += mergeAggregation<Key, Agg>(input, passSink, buffer, memSize, segsToMerge, blocksLeft, segmentSize, firstSegOffset, lastPass, lastMerge, ngroups);
+            newSortedSegs += 1;
+        }
+        free(blocksLeft);
+
+        if (lastMergeSegs == 0) {
+            lastSegmentSize = (memSize - 1) * segmentSize + lastSegmentSize;
+        } else {
+            lastSegmentSize = (lastMergeSegs - 1) * segmentSize + lastSegmentSize;
+        }
+        segmentSize *= memSize;
+        nSortedSegs = newSortedSegs;
+        closeTemp(input);
+        if (!lastPass) {
+            closeTemp(output);
+        }
+
+        char *tmp = tmpFile1;
+        tmpFile1 = tmpFile2;
+        tmpFile2 = tmp;
+    }
+    remove(tmpFile1);
+    remove(tmpFile2);
+    free(tmpName1);
+    free(tmpName2);
+    closeSpace(space);
+    endPhase();
+}
+
+// resolves the aggregate policy
+
+template <class Key>
+void aggregate(char *infile, unsigned char aggregation, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *ngroups, unsigned int *nios) {
+    switch (aggregation) {
+        case 0:
+            aggregate<Key, CountAgg>(infile, buffer, nmem_blocks, sink, ngroups, nios);
+            break;
+        case 1:
+            aggregate<Key, SumAgg>(infile, buffer, nmem_blocks, sink, ngroups, nios);
+            break;
+        case 2:
+            aggregate<Key, MinAgg>(infile, buffer, nmem_blocks, sink, ngroups, nios);
+            break;
+        default:
+            aggregate<Key, MaxAgg>(infile, buffer, nmem_blocks, sink, ngroups, nios);
+    }
+}
+
+void Aggregate(char *infile, unsigned char field, unsigned char aggregation, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *ngroups, unsigned int *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    AggregateSink(infile, field, aggregation, buffer, nmem_blocks, &sink, ngroups, nios);
+    closeFile(out);
+}
+
+void AggregateSink(char *infile, unsigned char field, unsigned char aggregation, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *ngroups, unsigned int *nios) {
+
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    switch (field) {
+        case 0:
+            aggregate<RecidKey>(infile, aggregation, buffer, nmem_blocks, sink, ngroups, nios);
+            break;
+        case 1:
+            aggregate<NumKey>(infile, aggregation, buffer, nmem_blocks, sink, ngroups, nios);
+            break;
+        case 2:
+            aggregate<StrKey>(infile, aggregation, buffer, nmem_blocks, sink, ngroups, nios);
+            break;
+        default:
+            aggregate<NumStrKey>(infile, aggregation, buffer, nmem_blocks, sink, ngroups, nios);
+    }
+}
@@ -29,12 +29,16 @@
 #include "bufferOps.h"
 #include "fileOps.h"
 #include "sortBuffer.h"
+#include "blockBatch.h"
+#include "pipeline.h"
+#include "blockSink.h"
+#include "opStats.h"
+#include "tempSpace.h"
 
 /*
  * infile: input filename
  * size: size in blocks of input file
- * outfile: output filename
- * field: which field will be used for sorting
+ * sink: receives the output blocks
  * buffer: the buffer that is used
  * memSize: number of buffer blocks available for use, without counting the last one, which is for output
  * nunique: number of unique values
@@ -44,8 +48,8 @@
  * hashes each record and writes it to the output, if a record of same value is not
  * found on the corresponding bucket.
  */
-void hashElimination(char *infile, uint size, char *outfile, unsigned char field, block_t *buffer, uint memSize, uint *nunique, uint *nios) {
-    int out = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+template <class Key>
+void hashElimination(char *infile, uint size, blockSink *sink, block_t *buffer, uint memSize, uint *nunique, uint *nios) {
     block_t *bufferOut = buffer + memSize;
     emptyBlock(bufferOut);
     (*bufferOut).valid = true;
@@ -63,25 +67,25 @@ void hashElimination(char *infile, uint size, char *outfile, unsigned char field
         hashIndex[i] = NULL;
     }
 
-    recordPtr start = newPtr(0);
-    recordPtr end = newPtr(size * MAX_RECORDS_PER_BLOCK - 1);
+    uint seed = hashSeed(infile);
 
-    for (; start <= end; incr(start)) {
-        if (!buffer[start.block].valid) {
-            start.record = MAX_RECORDS_PER_BLOCK - 1;
+    for (uint b = 0; b < size; b++) {
+        if (!buffer[b].valid) {
             continue;
         }
-        record_t record = getRecord(buffer, start);
-        if (record.valid) {
+        recordMask valid = validRecords(buffer + b);
+        for (int r = nextValid(valid); r >= 0; r = nextValid(valid)) {
+            recordPtr start = newPtr(b * MAX_RECORDS_PER_BLOCK + r);
+            const record_t &record = getRecord(buffer, start);
             // hashes the record being examined
-            uint index = hashRecord(infile, record, hashSize, field);
+            uint index = Key::hash(seed, record, hashSize);
             linkedRecordPtr *element = hashIndex[index];
             // goes through the linked list for the hash value of the record
             // if a record with same value is not found, then a recordPtr is
             // added to the linked list and the record itself is written to
             // the output. otherwise, it is ignored.
             while (element) {
-                if (compareRecords(record, getRecord(buffer, element->ptr), field) == 0) {
+                if (Key::compare(record, getRecord(buffer, element->ptr)) == 0) {
                     break;
                 }
                 element = element->next;
@@ -94,7 +98,7 @@ void hashElimination(char *infile, uint size, char *outfile, unsigned char field
                 (*bufferOut).entries[(*bufferOut).nreserved++] = record;
                 (*nunique) += 1;
                 if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
-                    (*nios) += writeBlocks(out, bufferOut, 1);
+                    (*nios) += putBlock(sink, bufferOut);
                     emptyBlock(bufferOut);
                     (*bufferOut).blockid += 1;
                 }
@@ -103,16 +107,14 @@ void hashElimination(char *infile, uint size, char *outfile, unsigned char field
     }
     // writes records left in buffer to the outfile
     if ((*bufferOut).nreserved != 0) {
-        (*nios) += writeBlocks(out, bufferOut, 1);
+        (*nios) += putBlock(sink, bufferOut);
     }
     destroyHashIndex(hashIndex, size);
-    close(out);
 }
 
 /*
  * infile: filename of the input file
- * outfile: filename of the output file
- * field: which field will be used for sorting
+ * sink: receives the output blocks
  * buffer: the buffer used
  * nmem_blocks: size of buffer
  * nunique: number of unique values
@@ -122,10 +124,10 @@ void hashElimination(char *infile, uint size, char *outfile, unsigned char field
  * sorted. then the first block is used as output where only unique values are
  * written
  */
-void useFirstBlock(char *infile, char *outfile, unsigned char field, block_t *buffer, uint nmem_blocks, uint *nunique, uint *nios) {
-    int out = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+template <class Key>
+void useFirstBlock(char *infile, blockSink *sink, block_t *buffer, uint nmem_blocks, uint *nunique, uint *nios) {
     (*nios) += readBlocks(infile, buffer, nmem_blocks);
-    if (sortBuffer(buffer, nmem_blocks, field)) {
+    if (sortBuffer<Key>(buffer, nmem_blocks)) {
         // all the unique values of the first block are shifted to the start
         // of it. the rest are marked as invalid
         recordPtr i = newPtr(1);
@@ -133,8 +135,8 @@ void useFirstBlock(char *infile, char *outfile, unsigned char field, block_t *bu
         (*nunique) += 1;
         buffer[0].nreserved = 1;
         for (; j.block < 1; incr(j)) {
-            record_t record = getRecord(buffer, j);
-            if (record.valid && compareRecords(record, getRecord(buffer, i - 1), field) != 0) {
+            const record_t &record = getRecord(buffer, j);
+            if (record.valid && Key::compare(record, getRecord(buffer, i - 1)) != 0) {
                 setRecord(buffer, record, i);
                 (*nunique) += 1;
                 incr(i);
@@ -147,14 +149,17 @@ void useFirstBlock(char *infile, char *outfile, unsigned char field, block_t *bu
             buffer[j.block].entries[j.record].valid = false;
         }
 
-        record_t *lastRecordAdded = (record_t*) malloc(sizeof (record_t));
-        record_t lastUnique = getRecord(buffer, i - 1);
-        memcpy(lastRecordAdded, &lastUnique, sizeof (record_t));
+        // the last unique value is read in place from the first block. it is
+        // only copied to lastFlushed when the first block is about to be emptied
+        record_t lastFlushed;
+        const record_t *lastRecordAdded = &getRecord(buffer, i - 1);
         // if the first block is full after the shifting (meaning that all its
         // values were actually unique), writes it to the outfile and empties it
         if (buffer[0].nreserved == MAX_RECORDS_PER_BLOCK) {
             i.block -= 1;
-            (*nios) += writeBlocks(out, buffer, 1);
+            (*nios) += putBlock(sink, buffer);
+            lastFlushed = *lastRecordAdded;
+            lastRecordAdded = &lastFlushed;
             emptyBlock(buffer);
             buffer[0].blockid += 1;
         }
@@ -164,38 +169,40 @@ void useFirstBlock(char *infile, char *outfile, unsigned char field, block_t *bu
         // has records not writtend yet, writes them to the outfile as well.
         j = newPtr(MAX_RECORDS_PER_BLOCK);
         while (buffer[j.block].valid && j.block < nmem_blocks) {
-            record_t record = getRecord(buffer, j);
+            const record_t &record = getRecord(buffer, j);
             if (!record.valid) {
                 break;
             }
-            if (compareRecords(record, (*lastRecordAdded), field) != 0) {
+            if (Key::compare(record, (*lastRecordAdded)) != 0) {
                 setRecord(buffer, record, i);
-                memcpy(lastRecordAdded, &record, sizeof (record_t));
+                lastRecordAdded = &getRecord(buffer, i);
                 (*nunique) += 1;
                 incr(i);
                 buffer[0].nreserved += 1;
             }
             if (buffer[0].nreserved == MAX_RECORDS_PER_BLOCK) {
                 i.block -= 1;
-                (*nios) += writeBlocks(out, buffer, 1);
+                (*nios) += putBlock(sink, buffer);
+                lastFlushed = *lastRecordAdded;
+                lastRecordAdded = &lastFlushed;
                 emptyBlock(buffer);
                 buffer[0].blockid += 1;
             }
             incr(j);
         }
         if (buffer[0].nreserved != 0) {
-            (*nios) += writeBlocks(out, buffer, 1);
+            (*nios) += putBlock(sink, buffer);
         }
-        free(lastRecordAdded);
     }
-    close(out);
 }
 
 // the following code is similar to merge from MergeSort.cpp
 // the only difference is that if lastPass is true, then each unique value is
-// written only once to the output
+// written only once to the output. the output is passed to a sink, which is
+// the one of the caller on the last pass
 
-uint mergeElimination(int &input, int &output, block_t *buffer, uint memSize, uint segsToMerge, uint *blocksLeft, uint segmentSize, uint firstSegOffset, unsigned char field, bool lastPass, bool lastMergeOfPass, uint *nunique) {
+template <class Key>
+uint mergeElimination(int &input, blockSink *output, block_t *buffer, uint memSize, uint segsToMerge, uint *blocksLeft, uint segmentSize, uint firstSegOffset, bool lastPass, bool lastMergeOfPass, uint *nunique) {
     uint ios = 0;
     block_t *bufferOut = buffer + memSize;
     uint blocksWritten = 0;
@@ -203,8 +210,10 @@ uint mergeElimination(int &input, int &output, block_t *buffer, uint memSize, ui
     if (lastMergeOfPass) {
         sizeOfLastSeg = blocksLeft[segsToMerge - 1] + 1;
     }
-    // holds the last unique value written to the output
-    record_t *lastRecordAdded = NULL;
+    // points to the last unique value written to the output, in place in the
+    // output block. it is only copied to lastFlushed when that block is emptied
+    const record_t *lastRecordAdded = NULL;
+    record_t lastFlushed;
 
     recordPtr *nextRecord = (recordPtr*) malloc(segsToMerge * sizeof (recordPtr));
     for (uint i = 0; i < segsToMerge; i++) {
@@ -222,37 +231,32 @@ uint mergeElimination(int &input, int &output, block_t *buffer, uint memSize, ui
                 break;
             }
         }
-        record_t minRec = getRecord(buffer, nextRecord[i]);
+        const record_t *minRec = &getRecord(buffer, nextRecord[i]);
         uint minBuffIndex = i;
 
         for (uint j = i + 1; j < segsToMerge; j++) {
-            if (buffer[j].valid && compareRecords(getRecord(buffer, nextRecord[j]), minRec, field) < 0) {
-                minRec = getRecord(buffer, nextRecord[j]);
+            if (buffer[j].valid && Key::compare(getRecord(buffer, nextRecord[j]), *minRec) < 0) {
+                minRec = &getRecord(buffer, nextRecord[j]);
                 minBuffIndex = j;
             }
         }
 
         if (!lastPass) {
-            (*bufferOut).entries[(*bufferOut).nreserved++] = minRec;
-        } else {
-            if (!lastRecordAdded) {
-                (*bufferOut).entries[(*bufferOut).nreserved++] = minRec;
-                (*nunique) += 1;
-                lastRecordAdded = (record_t*) malloc(sizeof (record_t));
-                memcpy(lastRecordAdded, &minRec, sizeof (record_t));
-            } else {
-                if (compareRecords(*lastRecordAdded, minRec, field) != 0) {
-                    (*bufferOut).entries[(*bufferOut).nreserved++] = minRec;
-                    (*nunique) += 1;
-                    memcpy(lastRecordAdded, &minRec, sizeof (record_t));
-                }
-            }
+            (*bufferOut).entries[(*bufferOut).nreserved++] = *minRec;
+        } else if (!lastRecordAdded || Key::compare(*lastRecordAdded, *minRec) != 0) {
+            (*bufferOut).entries[(*bufferOut).nreserved] = *minRec;
+            lastRecordAdded = (*bufferOut).entries + (*bufferOut).nreserved++;
+            (*nunique) += 1;
         }
 
         if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
-            ios += writeBlocks(output, bufferOut, 1);
+            ios += putBlock(output, bufferOut);
             (*bufferOut).blockid += 1;
             blocksWritten += 1;
+            if (lastRecordAdded) {
+                lastFlushed = *lastRecordAdded;
+                lastRecordAdded = &lastFlushed;
+            }
             emptyBlock(bufferOut);
         }
 
@@ -284,30 +288,29 @@ uint mergeElimination(int &input, int &output, block_t *buffer, uint memSize, ui
         }
     }
     free(nextRecord);
-    if (lastRecordAdded) {
-        free(lastRecordAdded);
-    }
 
     if ((*bufferOut).nreserved != 0) {
-        ios += writeBlocks(output, bufferOut, 1);
+        ios += putBlock(output, bufferOut);
         (*bufferOut).blockid += 1;
         blocksWritten += 1;
     }
 
-    if (!lastPass && !lastMergeOfPass) {
-        for (uint i = 0; i < segmentSize * segsToMerge - blocksWritten; i++) {
-            ios += writeBlocks(output, buffer, 1);
+    if (!lastPass) {
+        uint mergedSize = segmentSize * segsToMerge;
+        if (lastMergeOfPass) {
+            mergedSize = segmentSize * (segsToMerge - 1) + sizeOfLastSeg;
+        }
+        for (uint i = blocksWritten; i < mergedSize; i++) {
+            ios += putBlock(output, buffer);
         }
     }
     return ios;
 }
 
-void EliminateDuplicates(char *infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nunique, unsigned int *nios) {
+// eliminates duplicates of infile on the field of the key policy
 
-    if (nmem_blocks < 3) {
-        printf("At least 3 blocks are required.");
-        return;
-    }
+template <class Key>
+void eliminateDuplicates(char *infile, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nunique, unsigned int *nios) {
 
     // empties the buffer
     emptyBuffer(buffer, nmem_blocks);
@@ -320,10 +323,12 @@ void EliminateDuplicates(char *infile, unsigned char field, block_t *buffer, uns
     // if the relation fits on the buffer and leaves one block free for output,
     // loads it to the buffer and eliminates duplicates using hashing
     if (fileSize <= memSize) {
-        hashElimination(infile, fileSize, outfile, field, buffer, memSize, nunique, nios);
+        beginPhase("hashing", 1);
+        hashElimination<Key>(infile, fileSize, sink, buffer, memSize, nunique, nios);
     } else if (fileSize == nmem_blocks) {
         // if the relation completely fits the buffer, calls useFirstBlock
-        useFirstBlock(infile, outfile, field, buffer, nmem_blocks, nunique, nios);
+        beginPhase("hashing", 1);
+        useFirstBlock<Key>(infile, sink, buffer, nmem_blocks, nunique, nios);
     } else {
         // if the relation is larger than the buffer, then sort it using mergesort,
         // BUT during the final merging (during last pass) write to the output
@@ -332,14 +337,22 @@ void EliminateDuplicates(char *infile, unsigned char field, block_t *buffer, uns
         // the following code is similar to that of MergeSort:
 
         int input, output;
-        char tmpFile1[] = ".ed1";
-        char tmpFile2[] = ".ed2";
+        tempSpace space;
+        if (!openSpace(space)) {
+            endPhase();
+            return;
+        }
+        char *tmpName1 = tempPath(space, "ed1");
+        char *tmpName2 = tempPath(space, "ed2");
+        char *tmpFile1 = tmpName1;
+        char *tmpFile2 = tmpName2;
 
         uint fullSegments = fileSize / nmem_blocks;
         uint remainingSegment = fileSize % nmem_blocks;
 
+        beginPhase("run generation", 1);
         input = open(infile, O_RDONLY, S_IRWXU);
-        output = open(tmpFile1, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+        output = openTemp(tmpFile1, O_WRONLY | O_CREAT | O_TRUNC, true);
 
         uint nSortedSegs = 0;
         uint segmentSize = nmem_blocks;
@@ -352,13 +365,13 @@ void EliminateDuplicates(char *infile, unsigned char field, block_t *buffer, uns
                 }
             }
             (*nios) += readBlocks(input, buffer, segmentSize);
-            if (sortBuffer(buffer, segmentSize, field)) {
+            if (sortBuffer<Key>(buffer, segmentSize)) {
                 (*nios) += writeBlocks(output, buffer, segmentSize);
                 nSortedSegs += 1;
             }
         }
         close(input);
-        close(output);
+        closeTemp(output);
 
         segmentSize = nmem_blocks;
         uint lastSegmentSize;
@@ -369,9 +382,22 @@ void EliminateDuplicates(char *infile, unsigned char field, block_t *buffer, uns
         }
 
         buffer[memSize].valid = true;
-        while (nSortedSegs != 1) {
-            input = open(tmpFile1, O_RDONLY, S_IRWXU);
-            output = open(tmpFile2, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+        bool lastPass = false;
+        uint pass = 1;
+        while (!lastPass) {
+            // the output of the last pass, where each unique value is written
+            // once, is passed to sink
+            lastPass = nSortedSegs <= memSize;
+            pass += 1;
+            beginPhase("merge", pass);
+            input = openTemp(tmpFile1, O_RDONLY, false);
+            blockSink tmpSink;
+            blockSink *passSink = sink;
+            if (!lastPass) {
+                output = openTemp(tmpFile2, O_WRONLY | O_CREAT | O_TRUNC, true);
+                tmpSink = fileSink(output);
+                passSink = &tmpSink;
+            }
 
             uint newSortedSegs = 0;
             uint fullMerges = nSortedSegs / memSize;
@@ -395,15 +421,16 @@ void EliminateDuplicates(char *infile, unsigned char field, block_t *buffer, uns
                 }
 
                 for (uint i = 0; i < segsToMerge; i++) {
-                    (*nios) += preadBlocks(input, buffer + i, (firstSegOffset + i * segmentSize), 1);
+                    (*nios) += queueRead(input, buffer + i, (firstSegOffset + i * segmentSize), 1);
                     blocksLeft[i] = segmentSize - 1;
                 }
+                waitBlocks();
 
                 if (lastMerge) {
                     blocksLeft[segsToMerge - 1] = lastSegmentSize - 1;
                 }
 
-                (*nios) += mergeElimination(input, output, buffer, memSize, segsToMerge, blocksLeft, segmentSize, firstSegOffset, field, nSortedSegs <= memSize, lastMerge, nunique);
+                (*nios) += mergeElimination<Key>(input, passSink, buffer, memSize, segsToMerge, blocksLeft, segmentSize, firstSegOffset, lastPass, lastMerge, nunique);
                 newSortedSegs += 1;
             }
             free(blocksLeft);
@@ -415,14 +442,118 @@ void EliminateDuplicates(char *infile, unsigned char field, block_t *buffer, uns
             }
             segmentSize *= memSize;
             nSortedSegs = newSortedSegs;
-            close(input);
-            close(output);
+            closeTemp(input);
+            if (!lastPass) {
+                closeTemp(output);
+            }
 
-            char tmp = tmpFile1[3];
-            tmpFile1[3] = tmpFile2[3];
-            tmpFile2[3] = tmp;
+            char *tmp = tmpFile1;
+            tmpFile1 = tmpFile2;
+            tmpFile2 = tmp;
         }
-        rename(tmpFile1, outfile);
+        remove(tmpFile1);
         remove(tmpFile2);
+        free(tmpName1);
+        free(tmpName2);
+        closeSpace(space);
     }
-}
\ No newline at end of file
+    endPhase();
+}
+
+// state of a dedup iterator
+
+typedef struct {
+    blockIterator *input;
+    // the current block of input and the position of its next record
+    block_t *block;
+    uint pos;
+    block_t *bufferOut;
+    // points to the last unique record emitted, in place in bufferOut. it is
+    // copied to lastFlushed before bufferOut is emptied
+    const record_t *lastRecordAdded;
+    record_t lastFlushed;
+    uint *nunique;
+} dedupState;
+
+// returns the next block of unique records of the input
+
+template <class Key>
+block_t *nextUnique(blockIterator *it, uint *nios) {
+    dedupState &state = *(dedupState*) (*it).state;
+    block_t *bufferOut = state.bufferOut;
+    if (state.lastRecordAdded) {
+        state.lastFlushed = *state.lastRecordAdded;
+        state.lastRecordAdded = &state.lastFlushed;
+    }
+    emptyBlock(bufferOut);
+
+    const record_t *record;
+    while ((*bufferOut).nreserved < MAX_RECORDS_PER_BLOCK && (record = peekRecord(state.input, state.block, state.pos, nios))) {
+        if (!state.lastRecordAdded || Key::compare(*state.lastRecordAdded, *record) != 0) {
+            (*bufferOut).entries[(*bufferOut).nreserved] = *record;
+            state.lastRecordAdded = (*bufferOut).entries + (*bufferOut).nreserved++;
+            (*state.nunique) += 1;
+        }
+        state.pos += 1;
+    }
+    if ((*bufferOut).nreserved == 0) {
+        return NULL;
+    }
+    return bufferOut;
+}
+
+void closeDedup(blockIterator *it) {
+    dedupState *state = (dedupState*) (*it).state;
+    closeIterator((*state).input);
+    free(state);
+}
+
+blockIterator *openDedup(blockIterator *input, unsigned char field, block_t *bufferOut, uint *nunique) {
+    dedupState *state = (dedupState*) malloc(sizeof (dedupState));
+    (*state).input = input;
+    (*state).block = NULL;
+    (*state).pos = 0;
+    (*state).bufferOut = bufferOut;
+    (*state).lastRecordAdded = NULL;
+    (*state).nunique = nunique;
+    (*bufferOut).valid = true;
+    switch (field) {
+        case 0:
+            return newIterator(nextUnique<RecidKey>, closeDedup, state);
+        case 1:
+            return newIterator(nextUnique<NumKey>, closeDedup, state);
+        case 2:
+            return newIterator(nextUnique<StrKey>, closeDedup, state);
+        default:
+            return newIterator(nextUnique<NumStrKey>, closeDedup, state);
+    }
+}
+
+void EliminateDuplicates(char *infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nunique, unsigned int *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    EliminateDuplicatesSink(infile, field, buffer, nmem_blocks, &sink, nunique, nios);
+    closeFile(out);
+}
+
+void EliminateDuplicatesSink(char *infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nunique, unsigned int *nios) {
+
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    switch (field) {
+        case 0:
+            eliminateDuplicates<RecidKey>(infile, buffer, nmem_blocks, sink, nunique, nios);
+            break;
+        case 1:
+            eliminateDuplicates<NumKey>(infile, buffer, nmem_blocks, sink, nunique, nios);
+            break;
+        case 2:
+            eliminateDuplicates<StrKey>(infile, buffer, nmem_blocks, sink, nunique, nios);
+            break;
+        default:
+            eliminateDuplicates<NumStrKey>(infile, buffer, nmem_blocks, sink, nunique, nios);
+    }
+}
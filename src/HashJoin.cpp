@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <fcntl.h> 
 #include <unistd.h>
 #include <string.h>
@@ -30,16 +31,43 @@
 #include "recordOps.h"
 #include "bufferOps.h"
 #include "fileOps.h"
+#include "blockScan.h"
+#include "blockBatch.h"
+#include "blockSink.h"
+#include "opStats.h"
+#include "tempSpace.h"
+
+// the kinds of join. a semi-join outputs once each record of infile2 that has a
+// matching record on infile1, and an anti-join each one that has none
+
+enum joinMode {
+    INNER_JOIN,
+    SEMI_JOIN,
+    ANTI_JOIN
+};
+
+// adds a record to the output block. if it becomes full, passes it to sink and
+// empties it
+
+inline void outputRecord(blockSink *sink, block_t *bufferOut, const record_t &record, uint *nres, uint *nios) {
+    (*bufferOut).entries[(*bufferOut).nreserved++] = record;
+    (*nres) += 1;
+    if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
+        (*nios) += putBlock(sink, bufferOut);
+        emptyBlock(bufferOut);
+        (*bufferOut).blockid += 1;
+    }
+}
 
 /*
  * seed: seed to use in hash function
  * buffer: buffer used, already loaded with a relation to hash
  * size: the size in blocks of the relation loaded on buffer
- * field: which field will be used for joining
  * 
  * returns the pointer to the hash index
  */
-linkedRecordPtr** createHashIndex(char *seed, block_t *buffer, uint size, unsigned char field) {
+template <class Key>
+linkedRecordPtr** createHashIndex(uint seed, block_t *buffer, uint size) {
     // the hash index consists of a maximum of hashSize linked lists where
     // each list has pointers to the records with common hash value
 
@@ -50,19 +78,16 @@ linkedRecordPtr** createHashIndex(char *seed, block_t *buffer, uint size, unsign
         hashIndex[i] = NULL;
     }
 
-    recordPtr start = newPtr(0);
-    recordPtr end = newPtr(size * MAX_RECORDS_PER_BLOCK - 1);
-
-    // starting from the very first record, all valid records in valid blocks
+    // starting from the very first block, all valid records in valid blocks
     // are hashed
-    for (; start <= end; incr(start)) {
-        if (!buffer[start.block].valid) {
-            start.record = MAX_RECORDS_PER_BLOCK - 1;
+    for (uint b = 0; b < size; b++) {
+        if (!buffer[b].valid) {
             continue;
         }
-        record_t record = getRecord(buffer, start);
-        if (record.valid) {
-            uint index = hashRecord(seed, record, hashSize, field);
+        recordMask valid = validRecords(buffer + b);
+        for (int r = nextValid(valid); r >= 0; r = nextValid(valid)) {
+            recordPtr start = newPtr(b * MAX_RECORDS_PER_BLOCK + r);
+            uint index = Key::hash(seed, getRecord(buffer, start), hashSize);
             linkedRecordPtr *ptr = (linkedRecordPtr*) malloc(sizeof (linkedRecordPtr));
             ptr->ptr = start;
             ptr->next = hashIndex[index];
@@ -79,23 +104,26 @@ linkedRecordPtr** createHashIndex(char *seed, block_t *buffer, uint size, unsign
  * buffer: the buffer that is used (a file is already loaded on it)
  * nmem_blocks: size of buffer
  * size: the size of the file already loaded on buffer
- * out: file descriptor of the outfile
+ * seed: seed of the hash function
+ * sink: receives the output blocks
  * nres: number of pairs
  * nios: number of ios
- * field: which field will be used for joining
  */
-void hashAndProbe(char *infile, uint inBlocks, block_t *buffer, uint nmem_blocks, uint size, int &out, uint *nres, uint *nios, unsigned char field) {
+template <class Key>
+void hashAndProbe(char *infile, uint inBlocks, block_t *buffer, uint nmem_blocks, uint size, uint seed, blockSink *sink, uint *nres, uint *nios) {
     // hash index for the records already on buffer is created
-    linkedRecordPtr **hashIndex = createHashIndex(infile, buffer, size, field);
+    linkedRecordPtr **hashIndex = createHashIndex<Key>(seed, buffer, size);
+    beginPhase("probe", 0);
     // pointer to the buffer block where blocks of infile are loaded
-    block_t *bufferIn = buffer + nmem_blocks - 2;
+    block_t *bufferSlot = buffer + nmem_blocks - 2;
     // pointer to the last buffer block, where pairs for output are written
     block_t *bufferOut = buffer + nmem_blocks - 1;
 
-    int in = open(infile, O_RDONLY, S_IRWXU);
+    blockScan in;
+    openScan(in, infile);
     for (uint i = 0; i < inBlocks; i++) {
         // if the block loaded is invalid, loads the next one
-        (*nios) += readBlocks(in, bufferIn, 1);
+        block_t *bufferIn = nextBlock(in, bufferSlot, nios);
         if (!(*bufferIn).valid) {
             continue;
         }
@@ -103,34 +131,259 @@ void hashAndProbe(char *infile, uint inBlocks, block_t *buffer, uint nmem_blocks
         // then the linked list of the hash index for the corresponding hash value
         // is examined, and if a record has same value as the current one, both
         // are written to the output block
-        for (int j = 0; j < MAX_RECORDS_PER_BLOCK; j++) {
-            record_t record = (*bufferIn).entries[j];
-            if (record.valid) {
-                uint index = hashRecord(infile, record, size*MAX_RECORDS_PER_BLOCK, field);
-                linkedRecordPtr *element = hashIndex[index];
-                while (element) {
-                    record_t tmp = getRecord(buffer, element->ptr);
-                    if (compareRecords(record, tmp, field) == 0) {
-                        (*bufferOut).entries[(*bufferOut).nreserved++] = record;
-                        (*bufferOut).entries[(*bufferOut).nreserved++] = tmp;
-                        (*nres) += 1;
-                        // if output block becomes full, writes it to the outfile
-                        // and empties it
-                        if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
-                            (*nios) += writeBlocks(out, bufferOut, 1);
-                            emptyBlock(bufferOut);
-                            (*bufferOut).blockid += 1;
-                        }
+        recordMask valid = validRecords(bufferIn);
+        for (int j = nextValid(valid); j >= 0; j = nextValid(valid)) {
+            const record_t &record = (*bufferIn).entries[j];
+            uint index = Key::hash(seed, record, size*MAX_RECORDS_PER_BLOCK);
+            linkedRecordPtr *element = hashIndex[index];
+            while (element) {
+                const record_t &tmp = getRecord(buffer, element->ptr);
+                if (Key::compare(record, tmp) == 0) {
+                    (*bufferOut).entries[(*bufferOut).nreserved++] = record;
+                    (*bufferOut).entries[(*bufferOut).nreserved++] = tmp;
+                    (*nres) += 1;
+                    // if output block becomes full, writes it to the outfile
+                    // and empties it
+                    if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
+                        (*nios) += putBlock(sink, bufferOut);
+                        emptyBlock(bufferOut);
+                        (*bufferOut).blockid += 1;
                     }
-                    element = element->next;
                 }
+                element = element->next;
             }
         }
     }
-    close(in);
+    closeScan(in);
     destroyHashIndex(hashIndex, size);
 }
 
+/*
+ * infile: filename of the part of infile2 whose records are filtered
+ * inBlocks: size of infile
+ * buffer: the buffer that is used (the matching part of infile1 is already loaded on it)
+ * nmem_blocks: size of buffer
+ * size: the size of the part of infile1 already loaded on buffer
+ * seed: seed of the hash function
+ * mode: SEMI_JOIN or ANTI_JOIN
+ * sink: receives the output blocks
+ * nres: number of records in output
+ * nios: number of ios
+ *
+ * like hashAndProbe, but each record of infile is output at most once, on its
+ * own, and the linked list of its hash value is only examined up to its first
+ * match
+ */
+template <class Key>
+void hashAndFilter(char *infile, uint inBlocks, block_t *buffer, uint nmem_blocks, uint size, uint seed, joinMode mode, blockSink *sink, uint *nres, uint *nios) {
+    linkedRecordPtr **hashIndex = createHashIndex<Key>(seed, buffer, size);
+    beginPhase("probe", 0);
+    block_t *bufferSlot = buffer + nmem_blocks - 2;
+    block_t *bufferOut = buffer + nmem_blocks - 1;
+
+    blockScan in;
+    openScan(in, infile);
+    for (uint i = 0; i < inBlocks; i++) {
+        block_t *bufferIn = nextBlock(in, bufferSlot, nios);
+        if (!(*bufferIn).valid) {
+            continue;
+        }
+        recordMask valid = validRecords(bufferIn);
+        for (int j = nextValid(valid); j >= 0; j = nextValid(valid)) {
+            const record_t &record = (*bufferIn).entries[j];
+            uint index = Key::hash(seed, record, size * MAX_RECORDS_PER_BLOCK);
+            linkedRecordPtr *element = hashIndex[index];
+            while (element && Key::compare(record, getRecord(buffer, element->ptr)) != 0) {
+                element = element->next;
+            }
+            if ((element != NULL) == (mode == SEMI_JOIN)) {
+                outputRecord(sink, bufferOut, record, nres, nios);
+            }
+        }
+    }
+    closeScan(in);
+    destroyHashIndex(hashIndex, size);
+}
+
+/*
+ * infile: filename of the part of infile1 whose records are probed, or NULL if there is none
+ * inBlocks: size of infile
+ * buffer: the buffer that is used (a part of the matching part of infile2 is already loaded on it)
+ * nmem_blocks: size of buffer
+ * size: the size of the part of infile2 already loaded on buffer
+ * seed: seed of the hash function
+ * mode: SEMI_JOIN or ANTI_JOIN
+ * sink: receives the output blocks
+ * nres: number of records in output
+ * nios: number of ios
+ *
+ * used instead of hashAndFilter when the part of infile2 is the one on buffer.
+ * the records of buffer that match a probed record are marked and removed from
+ * the hash index, so that later records don't examine them again, and infile
+ * is no longer scanned once all of them are matched. then the records of
+ * buffer that are matched are output for a semi-join, the rest for an anti-join
+ */
+template <class Key>
+void hashAndMark(char *infile, uint inBlocks, block_t *buffer, uint nmem_blocks, uint size, uint seed, joinMode mode, blockSink *sink, uint *nres, uint *nios) {
+    block_t *bufferSlot = buffer + nmem_blocks - 2;
+    block_t *bufferOut = buffer + nmem_blocks - 1;
+    uint hashSize = size * MAX_RECORDS_PER_BLOCK;
+    bool *matched = (bool*) calloc(hashSize, sizeof (bool));
+
+    if (infile) {
+        linkedRecordPtr **hashIndex = createHashIndex<Key>(seed, buffer, size);
+        beginPhase("probe", 0);
+        uint unmatched = 0;
+        for (uint b = 0; b < size; b++) {
+            if (buffer[b].valid) {
+                recordMask valid = validRecords(buffer + b);
+                while (nextValid(valid) >= 0) {
+                    unmatched += 1;
+                }
+            }
+        }
+
+        blockScan in;
+        openScan(in, infile);
+        for (uint i = 0; i < inBlocks && unmatched != 0; i++) {
+            block_t *bufferIn = nextBlock(in, bufferSlot, nios);
+            if (!(*bufferIn).valid) {
+                continue;
+            }
+            recordMask valid = validRecords(bufferIn);
+            for (int j = nextValid(valid); j >= 0; j = nextValid(valid)) {
+                const record_t &record = (*bufferIn).entries[j];
+                linkedRecordPtr **link = hashIndex + Key::hash(seed, record, hashSize);
+                while (*link) {
+                    linkedRecordPtr *element = *link;
+                    if (Key::compare(record, getRecord(buffer, element->ptr)) == 0) {
+                        matched[getOffset(element->ptr)] = true;
+                        unmatched -= 1;
+                        *link = element->next;
+                        free(element);
+                    } else {
+                        link = &element->next;
+                    }
+                }
+            }
+        }
+        closeScan(in);
+        destroyHashIndex(hashIndex, size);
+    }
+
+    for (uint b = 0; b < size; b++) {
+        if (!buffer[b].valid) {
+            continue;
+        }
+        recordMask valid = validRecords(buffer + b);
+        for (int r = nextValid(valid); r >= 0; r = nextValid(valid)) {
+            if (matched[b * MAX_RECORDS_PER_BLOCK + r] == (mode == SEMI_JOIN)) {
+                outputRecord(sink, bufferOut, buffer[b].entries[r], nres, nios);
+            }
+        }
+    }
+    free(matched);
+}
+
+// the blocks the buckets of createBucketFiles are filled on, and the writes
+// of full blocks in flight
+
+typedef struct {
+    // the block of each bucket and the file descriptor of its bucket file, or -1
+    block_t **blocks;
+    int *files;
+    uint nbuckets;
+    // the blocks that hold no bucket
+    block_t **spare;
+    uint nspare;
+    // true for the buckets that have a write in flight
+    bool *writing;
+    // the blocks whose writes are in flight
+    block_t **flushed;
+    uint nflushed;
+} bucketFlushes;
+
+// puts the buckets on the first nbuckets of the size blocks of buffer. the
+// rest are spare
+
+void startFlushes(bucketFlushes &flushes, block_t *buffer, uint size, uint nbuckets) {
+    flushes.blocks = (block_t**) malloc(nbuckets * sizeof (block_t*));
+    flushes.files = (int*) malloc(nbuckets * sizeof (int));
+    flushes.writing = (bool*) malloc(nbuckets * sizeof (bool));
+    flushes.nbuckets = nbuckets;
+    for (uint i = 0; i < nbuckets; i++) {
+        flushes.blocks[i] = buffer + i;
+        flushes.files[i] = -1;
+        flushes.writing[i] = false;
+    }
+    flushes.spare = (block_t**) malloc(size * sizeof (block_t*));
+    flushes.nspare = 0;
+    for (uint i = nbuckets; i < size; i++) {
+        emptyBlock(buffer + i);
+        buffer[i].valid = true;
+        flushes.spare[flushes.nspare++] = buffer + i;
+    }
+    flushes.flushed = (block_t**) malloc(size * sizeof (block_t*));
+    flushes.nflushed = 0;
+}
+
+// waits for the writes in flight. their blocks are emptied and become spare
+
+void waitFlushes(bucketFlushes &flushes) {
+    if (flushes.nflushed == 0) {
+        return;
+    }
+    waitBlocks();
+    for (uint i = 0; i < flushes.nflushed; i++) {
+        emptyBlock(flushes.flushed[i]);
+        flushes.spare[flushes.nspare++] = flushes.flushed[i];
+    }
+    flushes.nflushed = 0;
+    for (uint i = 0; i < flushes.nbuckets; i++) {
+        flushes.writing[i] = false;
+    }
+}
+
+// submits the write of the full block of bucket index to the end of
+// filename, and gives the bucket a spare block. returns the number of ios
+
+uint flushBucket(bucketFlushes &flushes, uint index, char *filename) {
+    // only one append to a file may be in flight
+    if (flushes.writing[index]) {
+        waitFlushes(flushes);
+    }
+    if (flushes.files[index] == -1) {
+        flushes.files[index] = openFile(filename, O_WRONLY | O_CREAT | O_APPEND);
+    }
+    uint ios = queueAppend(flushes.files[index], flushes.blocks[index], 1);
+    submitBlocks();
+    flushes.flushed[flushes.nflushed++] = flushes.blocks[index];
+    flushes.writing[index] = true;
+    if (flushes.nspare == 0) {
+        waitFlushes(flushes);
+    }
+    flushes.blocks[index] = flushes.spare[--flushes.nspare];
+    return ios;
+}
+
+// closes the bucket files and empties the size blocks of buffer
+
+void endFlushes(bucketFlushes &flushes, block_t *buffer, uint size) {
+    for (uint i = 0; i < flushes.nbuckets; i++) {
+        if (flushes.files[i] != -1) {
+            closeFile(flushes.files[i]);
+        }
+    }
+    for (uint i = 0; i < size; i++) {
+        emptyBlock(buffer + i);
+    }
+    free(flushes.blocks);
+    free(flushes.files);
+    free(flushes.writing);
+    free(flushes.spare);
+    free(flushes.flushed);
+}
+
 /*
  * filename: the name of the file to be partitioned
  * size: the size of the file
@@ -140,46 +393,61 @@ void hashAndProbe(char *infile, uint inBlocks, block_t *buffer, uint nmem_blocks
  * bucketFilenames: array with the filenames of the bucket files to be produced
  * mod: to be used for hashing
  * nios: number of ios
- * field: which field will be used for joining
  */
-void createBucketFiles(char* filename, uint size, char* seed, block_t *buffer, uint nmem_blocks, char **bucketFilenames, uint mod, uint *nios, unsigned char field) {
+template <class Key>
+void createBucketFiles(char* filename, uint size, uint seed, block_t *buffer, uint nmem_blocks, char **bucketFilenames, uint mod, uint *nios) {
     // each block of the infile is loaded on the last block of buffer and each of its
     // records is hashed to one of the other buffer blocks. if a buffer block
     // becomes full, it is written to the correspoding bucket file
 
     // pointer to the last block of buffer, for convenience
-    block_t *bufferIn = buffer + nmem_blocks - 1;
-    int file = open(filename, O_RDONLY, S_IRWXU);
+    block_t *bufferSlot = buffer + nmem_blocks - 1;
+    // the blocks of buffer that hold no bucket are spare. the write of a full
+    // block is submitted without waiting and its bucket goes on with a spare
+    // block, so that hashing goes on while the write is done. once there are
+    // no spare blocks left, the writes in flight are waited for and their
+    // blocks become spare again. a bucket has one write in flight at most
+    bucketFlushes flushes;
+    startFlushes(flushes, buffer, nmem_blocks - 1, mod);
+    blockScan file;
+    openScan(file, filename);
     for (uint i = 0; i < size; i++) {
         // if the block loaded is invalid, loads the next one
-        (*nios) += readBlocks(file, bufferIn, 1);
+        block_t *bufferIn = nextBlock(file, bufferSlot, nios);
         if (!(*bufferIn).valid) {
             continue;
         }
         // each record of the current block is hashed
-        for (int j = 0; j < MAX_RECORDS_PER_BLOCK; j++) {
-            record_t record = (*bufferIn).entries[j];
-            if (record.valid) {
-                uint index = hashRecord(seed, record, mod, field);
-                buffer[index].entries[buffer[index].nreserved++] = record;
-                // if a buffer block becomes full, writes it to the corresponding
-                // bucket file
-                if (buffer[index].nreserved == MAX_RECORDS_PER_BLOCK) {
-                    (*nios) += writeBlocks(bucketFilenames[index], buffer + index, 1);
-                    emptyBlock(buffer + index);
-                }
+        recordMask valid = validRecords(bufferIn);
+        for (int j = nextValid(valid); j >= 0; j = nextValid(valid)) {
+            const record_t &record = (*bufferIn).entries[j];
+            uint index = Key::hash(seed, record, mod);
+            block_t *bucket = flushes.blocks[index];
+            (*bucket).entries[(*bucket).nreserved++] = record;
+            // if a buffer block becomes full, writes it to the corresponding
+            // bucket file
+            if ((*bucket).nreserved == MAX_RECORDS_PER_BLOCK) {
+                (*nios) += flushBucket(flushes, index, bucketFilenames[index]);
             }
         }
     }
 
-    // if any block has records left, writes them to the corresponding file
-    for (uint i = 0; i < nmem_blocks - 1; i++) {
-        if (buffer[i].nreserved != 0) {
-            (*nios) += writeBlocks(bucketFilenames[i], buffer + i, 1);
-            emptyBlock(buffer + i);
+    closeScan(file);
+
+    // if any block has records left, writes them to the corresponding file.
+    // the writes are submitted together and the blocks are emptied after
+    // all of them are done
+    waitFlushes(flushes);
+    for (uint i = 0; i < mod; i++) {
+        if ((*flushes.blocks[i]).nreserved != 0) {
+            if (flushes.files[i] == -1) {
+                flushes.files[i] = openFile(bucketFilenames[i], O_WRONLY | O_CREAT | O_APPEND);
+            }
+            (*nios) += queueAppend(flushes.files[i], flushes.blocks[i], 1);
         }
     }
-    close(file);
+    waitBlocks();
+    endFlushes(flushes, buffer, nmem_blocks - 1);
 }
 
 // using the infile's name, generates the name of its bucket file and returns it
@@ -193,44 +461,51 @@ inline char* extendFilename(const char* parentFilename, uint i) {
 /*
  * infile1: the first relation, or a part of it
  * infile2: the first relation, or a part of it
- * field: which field will be used for joining
  * buffer: the buffer that is used
  * memSize: size of buffer minus output spot
  * nres: number of pairs
  * nios: number of ios
  * firstCall: true if partition is called for the first time, meaning infile1 and infile2 are the original files
- * filenames: vector that holds the filenames of files that can be joined in a single pass
+ * space: the workspace the bucket files are created in
+ * filenames: vector that holds the pairs of filenames of files that can be joined, the part of infile1 first
+ * parentSize: the size of the smaller of the files that were partitioned to produce infile1 and infile2
+ * keepUnmatched: if true, a part of infile2 with no part of infile1 to match is kept, paired with NULL
+ * pass: the level of the partitioning, 1 for the original files
  */
-void partition(char *infile1, char *infile2, unsigned char field, block_t *buffer, uint memSize, uint *nres, uint *nios, bool firstCall, std::vector<char*> &filenames) {
+template <class Key>
+void partition(char *infile1, char *infile2, block_t *buffer, uint memSize, uint *nres, uint *nios, bool firstCall, tempSpace &space, std::vector<char*> &filenames, uint parentSize, bool keepUnmatched, uint pass) {
     uint size1 = getSize(infile1);
     uint size2 = getSize(infile2);
+    uint smallSize = size1;
+    if (size2 < smallSize) {
+        smallSize = size2;
+    }
 
     // if either of the infiles fits in nmem_blocks - 2,
     // then they can be joined in a single pass so pushes the filenames
-    // on the vector. the filename of the smaller file is pushed first
-    if (size1 < memSize || size2 < memSize) {
-        if (size1 <= size2) {
-            filenames.push_back(infile1);
-            filenames.push_back(infile2);
-        } else {
-            filenames.push_back(infile2);
-            filenames.push_back(infile1);
-        }
+    // on the vector. so does it if partitioning did not make them any smaller,
+    // which happens when most of their records have the same value. then the
+    // smaller one is loaded on the buffer in parts
+    if (smallSize < memSize || smallSize >= parentSize) {
+        filenames.push_back(infile1);
+        filenames.push_back(infile2);
     } else {
         // if the infiles cannot be joined in a single pass, creates subfiles (bucketfiles)
         // and recursively calls partition for each pair of them
 
         // figure out how many buckets to create
-        uint smallSize = size1;
-        if (size2 < smallSize) {
-            smallSize = size2;
-        }
         uint bucketCount = smallSize / (memSize - 1);
         if (smallSize % (memSize - 1)) {
             bucketCount += 1;
         }
-        if (bucketCount > memSize) {
-            bucketCount = memSize;
+        // when the writes go through io_uring, one block is kept spare, so
+        // that hashing goes on while a full block is written
+        uint maxBuckets = memSize;
+        if (memSize > 2 && batchAsync()) {
+            maxBuckets = memSize - 1;
+        }
+        if (bucketCount > maxBuckets) {
+            bucketCount = maxBuckets;
         }
         
         // arrays with the filenames for the subfiles to be produced
@@ -238,39 +513,52 @@ void partition(char *infile1, char *infile2, unsigned char field, block_t *buffe
         char **bucketFilenames2 = (char**) malloc(bucketCount * sizeof (char*));
 
         if (firstCall) {
+            char *root1 = tempPath(space, "hj1");
+            char *root2 = tempPath(space, "hj2");
             for (uint i = 0; i < bucketCount; i++) {
-                bucketFilenames1[i] = extendFilename(".hj1", i);
-                bucketFilenames2[i] = extendFilename(".hj2", i);
+                bucketFilenames1[i] = extendFilename(root1, i);
+                bucketFilenames2[i] = extendFilename(root2, i);
             }
+            free(root1);
+            free(root2);
         } else {
             for (uint i = 0; i < bucketCount; i++) {
                 bucketFilenames1[i] = extendFilename(infile1, i);
                 bucketFilenames2[i] = extendFilename(infile2, i);
             }
         }
+        // both infiles are hashed with the same seed, so that matching
+        // records end up in bucket files with the same index
+        beginPhase("partition", pass);
+        uint seed = hashSeed(spaceName(space, infile1));
         // calls createBucketFiles for infile1
-        createBucketFiles(infile1, size1, infile1, buffer, memSize + 1, bucketFilenames1, bucketCount, nios, field);
+        createBucketFiles<Key>(infile1, size1, seed, buffer, memSize + 1, bucketFilenames1, bucketCount, nios);
         // after the files are created, removes infile1 if it's not the original one
         if (!firstCall) {
             remove(infile1);
         }
         // same for infile2
-        createBucketFiles(infile2, size2, infile1, buffer, memSize + 1, bucketFilenames2, bucketCount, nios, field);
+        createBucketFiles<Key>(infile2, size2, seed, buffer, memSize + 1, bucketFilenames2, bucketCount, nios);
         if (!firstCall) {
             remove(infile2);
             free(infile1);
             free(infile2);
         }
         // for each pair of bucket files, if both of them exist, partition is called.
-        // otherwise they are both removed.
+        // otherwise they are both removed, unless the bucket file of infile2 is
+        // to be kept
         for (uint i = 0; i < bucketCount; i++) {
-            if (!exists(bucketFilenames1[i]) || !exists(bucketFilenames2[i])) {
+            if (exists(bucketFilenames1[i]) && exists(bucketFilenames2[i])) {
+                partition<Key>(bucketFilenames1[i], bucketFilenames2[i], buffer, memSize, nres, nios, false, space, filenames, smallSize, keepUnmatched, pass + 1);
+            } else if (keepUnmatched && exists(bucketFilenames2[i])) {
+                free(bucketFilenames1[i]);
+                filenames.push_back(NULL);
+                filenames.push_back(bucketFilenames2[i]);
+            } else {
                 remove(bucketFilenames1[i]);
                 remove(bucketFilenames2[i]);
                 free(bucketFilenames1[i]);
                 free(bucketFilenames2[i]);
-            } else {
-                partition(bucketFilenames1[i], bucketFilenames2[i], field, buffer, memSize, nres, nios, false, filenames);
             }
         }
         // memory allocated for the arrays with the bucket filenames is freed
@@ -279,12 +567,74 @@ void partition(char *infile1, char *infile2, unsigned char field, block_t *buffe
     }
 }
 
-void HashJoin(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
-    if (nmem_blocks < 3) {
-        printf("At least 3 blocks are required.");
+/*
+ * part1: a part of infile1 produced by partition, or NULL
+ * size1: the size of part1
+ * part2: the matching part of infile2
+ * size2: the size of part2
+ * buffer: the buffer that is used
+ * nmem_blocks: size of buffer
+ * space: the workspace of the join, so that the parts are hashed on their
+ * names in it, which are the same from run to run
+ * mode: the kind of join
+ * sink: receives the output blocks
+ * nres: number of pairs, or records for a semi-join or anti-join
+ * nios: number of ios
+ *
+ * joins a pair of parts. the smaller one is loaded on the buffer and the other
+ * one is probed. if it doesn't fit on nmem_blocks - 2 blocks, it is loaded in
+ * as many parts as needed and the other one is probed once for each. a part of
+ * infile1 is only loaded for a semi-join or anti-join if it fits, because the
+ * records of infile2 are filtered by all of it
+ */
+template <class Key>
+void joinParts(char *part1, uint size1, char *part2, uint size2, block_t *buffer, uint nmem_blocks, tempSpace &space, joinMode mode, blockSink *sink, uint *nres, uint *nios) {
+    uint memSize = nmem_blocks - 2;
+    if (mode != INNER_JOIN && size1 != 0 && size1 <= memSize && size1 <= size2) {
+        beginPhase("build", 0);
+        (*nios) += readBlocks(part1, buffer, size1);
+        hashAndFilter<Key>(part2, size2, buffer, nmem_blocks, size1, hashSeed(spaceName(space, part2)), mode, sink, nres, nios);
         return;
     }
-    system("rm .hj* -f");
+
+    char *loaded = part2;
+    uint loadedSize = size2;
+    char *probed = size1 != 0 ? part1 : NULL;
+    uint probedSize = size1;
+    if (mode == INNER_JOIN) {
+        if (size1 == 0 || size2 == 0) {
+            return;
+        }
+        if (size1 <= size2) {
+            loaded = part1;
+            loadedSize = size1;
+            probed = part2;
+            probedSize = size2;
+        }
+    }
+
+    uint seed = probed ? hashSeed(spaceName(space, probed)) : 0;
+    int in = open(loaded, O_RDONLY, S_IRWXU);
+    for (uint offset = 0; offset < loadedSize; offset += memSize) {
+        uint size = loadedSize - offset;
+        if (size > memSize) {
+            size = memSize;
+        }
+        beginPhase("build", 0);
+        (*nios) += readBlocks(in, buffer, size);
+        if (mode == INNER_JOIN) {
+            hashAndProbe<Key>(probed, probedSize, buffer, nmem_blocks, size, seed, sink, nres, nios);
+        } else {
+            hashAndMark<Key>(probed, probedSize, buffer, nmem_blocks, size, seed, mode, sink, nres, nios);
+        }
+    }
+    close(in);
+}
+
+// hash joins infile1 and infile2 on the field of the key policy
+
+template <class Key>
+void hashJoin(char *infile1, char *infile2, joinMode mode, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios) {
     emptyBuffer(buffer, nmem_blocks);
 
     (*nres) = 0;
@@ -296,35 +646,99 @@ void HashJoin(char *infile1, char *infile2, unsigned char field, block_t *buffer
     // of them fits on nmem_blocks - 2 blocks. each pair will be joined
     // using single-pass hashing
     std::vector<char*> filenames;
+    // the bucket files are created in a workspace of this join
+    tempSpace space;
+    if (!openSpace(space)) {
+        return;
+    }
     // partitions the original files in smaller ones that can be joined in as single pass
-    partition(infile1, infile2, field, buffer, nmem_blocks - 1, nres, nios, true, filenames);
+    partition<Key>(infile1, infile2, buffer, nmem_blocks - 1, nres, nios, true, space, filenames, UINT_MAX, mode == ANTI_JOIN, 1);
     emptyBlock(bufferOut);
     (*bufferOut).valid = true;
     (*bufferOut).blockid = 0;
 
-    int out = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
     if (filenames.size() != 0) {
         // joins the pairs of files and the writes the pairs on the outfile
         for (uint i = 0; i < filenames.size() - 1; i += 2) {
-            uint size1 = getSize(filenames[i]);
-            (*nios) += readBlocks(filenames[i], buffer, size1);
-
-            hashAndProbe(filenames[i + 1], getSize(filenames[i + 1]), buffer, nmem_blocks, size1, out, nres, nios, field);
+            char *part1 = filenames[i];
+            char *part2 = filenames[i + 1];
+            uint size1 = part1 ? getSize(part1) : 0;
+            joinParts<Key>(part1, size1, part2, getSize(part2), buffer, nmem_blocks, space, mode, sink, nres, nios);
 
             // if the files joined are not the original ones, remove them and free
             // memory allocated for their names
-            if (!strcmp(filenames[i], infile1) == 0 && !strcmp(filenames[i + 1], infile1) == 0) {
-                remove(filenames[i]);
-                remove(filenames[i + 1]);
-                free(filenames[i]);
-                free(filenames[i + 1]);
+            if (part2 != infile2) {
+                if (part1) {
+                    remove(part1);
+                    free(part1);
+                }
+                remove(part2);
+                free(part2);
             }
         }
         filenames.clear();
         // if there are pairs left on the buffer, writes them to the output
         if ((*bufferOut).nreserved != 0) {
-            (*nios) += writeBlocks(out, bufferOut, 1);
+            (*nios) += putBlock(sink, bufferOut);
         }
     }
-    close(out);
-}
\ No newline at end of file
+    closeSpace(space);
+    endPhase();
+}
+
+void HashJoin(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    HashJoinSink(infile1, infile2, field, buffer, nmem_blocks, &sink, nres, nios);
+    closeFile(out);
+}
+
+void HashJoinSink(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios) {
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    switch (field) {
+        case 0:
+            hashJoin<RecidKey>(infile1, infile2, INNER_JOIN, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        case 1:
+            hashJoin<NumKey>(infile1, infile2, INNER_JOIN, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        case 2:
+            hashJoin<StrKey>(infile1, infile2, INNER_JOIN, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        default:
+            hashJoin<NumStrKey>(infile1, infile2, INNER_JOIN, buffer, nmem_blocks, sink, nres, nios);
+    }
+}
+
+void HashSemiJoin(char *infile1, char *infile2, unsigned char field, bool anti, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    HashSemiJoinSink(infile1, infile2, field, anti, buffer, nmem_blocks, &sink, nres, nios);
+    closeFile(out);
+}
+
+void HashSemiJoinSink(char *infile1, char *infile2, unsigned char field, bool anti, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios) {
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    joinMode mode = anti ? ANTI_JOIN : SEMI_JOIN;
+    switch (field) {
+        case 0:
+            hashJoin<RecidKey>(infile1, infile2, mode, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        case 1:
+            hashJoin<NumKey>(infile1, infile2, mode, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        case 2:
+            hashJoin<StrKey>(infile1, infile2, mode, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        default:
+            hashJoin<NumStrKey>(infile1, infile2, mode, buffer, nmem_blocks, sink, nres, nios);
+    }
+}
@@ -0,0 +1,269 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h> 
+#include <unistd.h>
+#include <math.h>
+
+#include "dbtproj.h"
+#include "recordOps.h"
+#include "bufferOps.h"
+#include "fileOps.h"
+#include "sortBuffer.h"
+#include "opStats.h"
+
+// number of blocks of each file that are sampled for key statistics
+#define SAMPLE_BLOCKS 4
+// number of record comparisons or hashes that cost as much as one block io.
+// used to add the cpu cost of each strategy to its io cost
+#define RECORD_OPS_PER_IO 1000.0
+
+// statistics of a file, estimated from a sample of its blocks
+
+struct fileStats {
+    // size in blocks
+    uint blocks;
+    // estimated number of valid records
+    double records;
+    // estimated number of distinct values of field
+    double distinct;
+};
+
+// predicted cost of a join strategy
+
+struct joinCost {
+    // block ios, including the ones for writing the output
+    double ios;
+    // record comparisons and hashes
+    double ops;
+};
+
+/*
+ * filename: the file to sample
+ * field: which field will be used for the join
+ * buffer: the buffer used
+ * sampleSize: number of buffer blocks that may be used for the sample
+ * stats: the statistics estimated
+ * nios: number of ios
+ *
+ * loads sampleSize blocks spread evenly over the file, sorts them and counts
+ * how many times each value appears. the number of distinct values of the
+ * whole file is estimated from the values seen once and twice (chao1).
+ *
+ * returns the number of sampled blocks, which are left sorted on buffer
+ */
+uint sampleFile(char *filename, unsigned char field, block_t *buffer, uint sampleSize, fileStats &stats, uint *nios) {
+    stats.blocks = getSize(filename);
+    stats.records = 0;
+    stats.distinct = 0;
+    if (stats.blocks < sampleSize) {
+        sampleSize = stats.blocks;
+    }
+    if (sampleSize == 0) {
+        return 0;
+    }
+
+    int in = open(filename, O_RDONLY, S_IRWXU);
+    for (uint i = 0; i < sampleSize; i++) {
+        (*nios) += preadBlocks(in, buffer + i, i * (stats.blocks / sampleSize), 1);
+    }
+    close(in);
+    if (!sortBuffer(buffer, sampleSize, field)) {
+        return sampleSize;
+    }
+
+    // counts the sampled records, the distinct values among them and how many
+    // of these values were seen once and twice
+    double sampled = 0, seen = 0, once = 0, twice = 0;
+    uint count = 0;
+    recordPtr ptr = newPtr(0);
+    recordPtr end = newPtr(sampleSize * MAX_RECORDS_PER_BLOCK - 1);
+    for (; ptr <= end && getRecord(buffer, ptr).valid; incr(ptr)) {
+        sampled += 1;
+        count += 1;
+        if (ptr == end || !getRecord(buffer, ptr + 1).valid || compareRecords(getRecord(buffer, ptr), getRecord(buffer, ptr + 1), field) != 0) {
+            seen += 1;
+            if (count == 1) {
+                once += 1;
+            } else if (count == 2) {
+                twice += 1;
+            }
+            count = 0;
+        }
+    }
+
+    stats.records = sampled * stats.blocks / sampleSize;
+    stats.distinct = seen + once * (once - 1) / (2 * (twice + 1));
+    if (stats.distinct > stats.records) {
+        stats.distinct = stats.records;
+    }
+    return sampleSize;
+}
+
+/*
+ * blocks: size of the file to be sorted
+ * nmem_blocks: number of blocks in memory
+ * cost: the cost of sorting is added to it
+ *
+ * follows MergeSort: sorted segments of nmem_blocks blocks are created and then
+ * merged nmem_blocks - 1 at a time. each pass reads and writes the whole file
+ */
+void addSortCost(double blocks, uint nmem_blocks, joinCost &cost) {
+    if (blocks == 0) {
+        return;
+    }
+    double records = blocks * MAX_RECORDS_PER_BLOCK;
+    double segments = ceil(blocks / nmem_blocks);
+    double mergePasses = 0;
+    if (segments > 1) {
+        mergePasses = ceil(log(segments) / log(nmem_blocks - 1));
+    }
+    cost.ios += 2 * blocks * (1 + mergePasses);
+    cost.ops += records * log2(fmin(blocks, nmem_blocks) * MAX_RECORDS_PER_BLOCK);
+    cost.ops += records * (nmem_blocks - 1) * mergePasses;
+}
+
+// predicts the cost of MergeJoin, following its two cases
+
+joinCost mergeJoinCost(fileStats &stats1, fileStats &stats2, uint nmem_blocks, double outBlocks) {
+    joinCost cost;
+    cost.ios = outBlocks;
+    cost.ops = stats1.records + stats2.records;
+    uint memSize = nmem_blocks - 1;
+    fileStats *small = &stats1, *big = &stats2;
+    if (stats2.blocks < stats1.blocks) {
+        small = &stats2;
+        big = &stats1;
+    }
+    if ((*small).blocks < memSize) {
+        // one file is loaded and sorted on buffer, the other is sorted with
+        // MergeSort and scanned once. if both fit, the larger is the one loaded
+        if ((*big).blocks < memSize) {
+            fileStats *tmp = small;
+            small = big;
+            big = tmp;
+        }
+        cost.ios += (*small).blocks;
+        cost.ops += (*small).records * log2((*small).records + 1);
+        addSortCost((*big).blocks, nmem_blocks, cost);
+        cost.ios += (*big).records / MAX_RECORDS_PER_BLOCK;
+    } else {
+        // both are sorted with MergeSort and then scanned once
+        addSortCost(stats1.blocks, nmem_blocks, cost);
+        addSortCost(stats2.blocks, nmem_blocks, cost);
+        cost.ios += (stats1.records + stats2.records) / MAX_RECORDS_PER_BLOCK;
+    }
+    return cost;
+}
+
+// predicts the cost of HashJoin, following its partitioning.
+// if a single value of the smaller file does not fit on buffer, partitioning
+// cannot split it, so the cost is infinite
+
+joinCost hashJoinCost(fileStats &stats1, fileStats &stats2, uint nmem_blocks, double outBlocks) {
+    joinCost cost;
+    cost.ios = outBlocks;
+    cost.ops = 0;
+    uint memSize = nmem_blocks - 1;
+    fileStats *small = &stats1, *big = &stats2;
+    if (stats2.blocks < stats1.blocks) {
+        small = &stats2;
+        big = &stats1;
+    }
+
+    // each partitioning level reads and writes both files, until the buckets
+    // of the smaller one fit in memSize - 1 blocks
+    double smallBlocks = (*small).blocks;
+    double bigBlocks = (*big).blocks;
+    double levels = 0;
+    while (smallBlocks >= memSize) {
+        if ((*small).distinct == 0 || (*small).records / (*small).distinct > (memSize - 1) * MAX_RECORDS_PER_BLOCK) {
+            cost.ios = INFINITY;
+            return cost;
+        }
+        double bucketCount = fmin(ceil(smallBlocks / (memSize - 1)), memSize);
+        cost.ios += 2 * (smallBlocks + bigBlocks);
+        cost.ops += ((*small).records + (*big).records);
+        smallBlocks = ceil(smallBlocks / bucketCount);
+        bigBlocks = ceil(bigBlocks / bucketCount);
+        levels += 1;
+    }
+    cost.ios += (*small).blocks + (*big).blocks;
+    // the records of one file are hashed in the index, the other's are probed
+    // and compared to the records of the same hash value
+    cost.ops += (*small).records + (*big).records;
+    if ((*small).distinct > 0) {
+        cost.ops += (*big).records * (*small).records / (*small).distinct;
+    }
+    return cost;
+}
+
+// total cost of a strategy, in block ios
+
+inline double totalCost(joinCost cost) {
+    return cost.ios + cost.ops / RECORD_OPS_PER_IO;
+}
+
+void Join(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    // half of the buffer at most is used for the sample of each file
+    uint sampleSize = SAMPLE_BLOCKS;
+    if (sampleSize > nmem_blocks / 2) {
+        sampleSize = nmem_blocks / 2;
+    }
+    uint sampleIos = 0;
+    fileStats stats1, stats2;
+    beginPhase("sampling", 0);
+    sampleFile(infile1, field, buffer, sampleSize, stats1, &sampleIos);
+    sampleFile(infile2, field, buffer, sampleSize, stats2, &sampleIos);
+
+    // under the assumption that the values of the file with fewer distinct
+    // values are contained in the other, each pair of records with equal
+    // value is joined, so the pairs are (records1 * records2) / max(distinct)
+    double pairs = 0;
+    double maxDistinct = fmax(stats1.distinct, stats2.distinct);
+    if (maxDistinct > 0) {
+        pairs = stats1.records * stats2.records / maxDistinct;
+    }
+    // two records per pair are written to the output
+    double outBlocks = ceil(2 * pairs / MAX_RECORDS_PER_BLOCK);
+
+    joinCost mergeCost = mergeJoinCost(stats1, stats2, nmem_blocks, outBlocks);
+    joinCost hashCost = hashJoinCost(stats1, stats2, nmem_blocks, outBlocks);
+    bool useHash = totalCost(hashCost) <= totalCost(mergeCost);
+
+    if (useHash) {
+        HashJoin(infile1, infile2, field, buffer, nmem_blocks, outfile, nres, nios);
+    } else {
+        MergeJoin(infile1, infile2, field, buffer, nmem_blocks, outfile, nres, nios);
+    }
+    (*nios) += sampleIos;
+
+    // logs the decision, so that the cost model can be tuned
+    printf("Join: %s chosen, cost merge = %.0f, hash = %.0f\n", useHash ? "HashJoin" : "MergeJoin", totalCost(mergeCost), totalCost(hashCost));
+    printf("Join: predicted nios = %.0f, nres = %.0f, actual nios = %u, nres = %u\n", (useHash ? hashCost.ios : mergeCost.ios) + sampleIos, pairs, *nios, *nres);
+}
@@ -29,6 +29,12 @@
 #include "bufferOps.h"
 #include "fileOps.h"
 #include "sortBuffer.h"
+#include "blockScan.h"
+#include "bufferPool.h"
+#include "pipeline.h"
+#include "blockSink.h"
+#include "opStats.h"
+#include "tempSpace.h"
 
 // struct that holds the last value joined (the whole record is stored but only
 // the value of a field is needed) and the blockId of the block this value
@@ -39,10 +45,170 @@ struct blockToLoad {
     record_t *lastValueJoined;
 };
 
+// given a block of a sorted relation whose i-th record has no pair, returns
+// the index of the last of the following records that are lower than rec
+// (or i itself if there is none), so that the caller can skip them
+
+template <class Key>
+int skipLowerRecords(block_t *block, int i, const record_t &rec) {
+    if (i + 1 >= (int) (*block).nreserved) {
+        return i;
+    }
+    return getOffset(gallopSearch<Key>(block, newPtr(i + 1), newPtr((*block).nreserved - 1), rec)) - 1;
+}
+
+// returns true if the last record of a block of a sorted relation is lower than rec.
+// a block with no records is only found at the end of the relation, so it is
+// considered to be higher
+
+template <class Key>
+inline bool blockIsLower(block_t *block, const record_t &rec) {
+    if ((*block).nreserved == 0) {
+        return false;
+    }
+    return Key::compare((*block).entries[(*block).nreserved - 1], rec) < 0;
+}
+
+// pins block id of the smaller relation, returns true if it is lower than rec
+// and unpins it
+
+template <class Key>
+bool probeIsLower(bufferPool &pool, int in, uint id, const record_t &rec, uint *nios) {
+    block_t *block = pinBlock(pool, in, id, nios);
+    bool lower = blockIsLower<Key>(block, rec);
+    unpinBlock(pool, block);
+    return lower;
+}
+
+/*
+ * pool: the buffer pool that holds the blocks of the sorted smaller relation
+ * in: file descriptor of the sorted smaller relation
+ * fileSize1: size in blocks of the smaller relation
+ * blockId: the id of a block of the smaller relation that is lower than rec
+ * rec: the record of the bigger relation being joined
+ * nios: number of ios
+ *
+ * instead of reading the blocks after blockId one by one, finds the first one
+ * whose last record is not lower than rec by probing blocks at doubling
+ * distances and then binary searching between the last two, so blocks that
+ * cannot be joined are not read at all. blocks still in the pool are not reread.
+ *
+ * returns the id of that block, or fileSize1 if there is none
+ */
+template <class Key>
+uint seekBlock(bufferPool &pool, int in, uint fileSize1, uint blockId, const record_t &rec, uint *nios) {
+    // lower is always a block lower than rec, upper is a block not lower than rec
+    uint lower = blockId;
+    uint upper = fileSize1;
+    uint step = 1;
+    while (lower < fileSize1 - 1) {
+        uint probe = lower + step;
+        if (probe > fileSize1 - 1) {
+            probe = fileSize1 - 1;
+        }
+        if (!probeIsLower<Key>(pool, in, probe, rec, nios)) {
+            upper = probe;
+            break;
+        }
+        lower = probe;
+        step *= 2;
+    }
+    if (upper == fileSize1) {
+        return fileSize1;
+    }
+    while (upper - lower > 1) {
+        uint middle = lower + (upper - lower) / 2;
+        if (probeIsLower<Key>(pool, in, middle, rec, nios)) {
+            lower = middle;
+        } else {
+            upper = middle;
+        }
+    }
+    return upper;
+}
+
+// unpins block of the smaller relation and pins block id instead
+
+inline block_t *moveToBlock(bufferPool &pool, int in, block_t *block, uint id, uint *nios) {
+    unpinBlock(pool, block);
+    return pinBlock(pool, in, id, nios);
+}
+
+// where a merge join writes its pairs. the relation that is scanned block by
+// block is written first, unless swap is set. for outer joins swap is set so
+// that the record of infile1 is always the first
+
+typedef struct {
+    blockSink *sink;
+    block_t *bufferOut;
+    bool swap;
+    uint *nres;
+} joinOutput;
+
+// writes the pair of a record of the scanned relation and one of the other to
+// the output block. if it becomes full, passes it to sink and empties it
+
+inline void outputPair(joinOutput &out, const record_t &scanned, const record_t &other, uint *nios) {
+    block_t *bufferOut = out.bufferOut;
+    if (out.swap) {
+        (*bufferOut).entries[(*bufferOut).nreserved++] = other;
+        (*bufferOut).entries[(*bufferOut).nreserved++] = scanned;
+    } else {
+        (*bufferOut).entries[(*bufferOut).nreserved++] = scanned;
+        (*bufferOut).entries[(*bufferOut).nreserved++] = other;
+    }
+    (*out.nres) += 1;
+    if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
+        (*nios) += putBlock(out.sink, bufferOut);
+        emptyBlock(bufferOut);
+        (*bufferOut).blockid += 1;
+    }
+}
+
+// for outer joins. writes the records of block of the relation that is not
+// scanned, from done up to (not including) to, with no pair, apart from the
+// ones equal to lastJoined, which have been joined. done is moved to to
+
+template <class Key>
+void outputUnjoined(block_t *block, recordPtr &done, recordPtr to, const record_t *lastJoined, joinOutput &out, uint *nios) {
+    for (; done < to; incr(done)) {
+        const record_t &record = getRecord(block, done);
+        if (!lastJoined || Key::compare(record, *lastJoined) != 0) {
+            outputPair(out, nullRecord(), record, nios);
+        }
+    }
+}
+
+// for outer joins. writes the valid records of a block of the scanned relation,
+// starting from the i-th one, with no pair
+
+inline void outputScanned(block_t *block, int i, joinOutput &out, uint *nios) {
+    if (!(*block).valid) {
+        return;
+    }
+    recordMask valid = validRecords(block);
+    for (int r = nextValid(valid); r >= 0; r = nextValid(valid)) {
+        if (r >= i) {
+            outputPair(out, (*block).entries[r], nullRecord(), nios);
+        }
+    }
+}
+
+// for outer joins. writes the records of the next size blocks of a scan with no pair
+
+inline void outputScan(blockScan &in, uint size, block_t *bufferSlot, joinOutput &out, uint *nios) {
+    for (uint i = 0; i < size; i++) {
+        outputScanned(nextBlock(in, bufferSlot, nios), 0, out, nios);
+    }
+}
+
 // called if at least one of the files fits in nmem_blocks - 2.
-// sorts one file using MergeSort, while the other is loaded on buffer and sorted there
+// sorts one file using MergeSort, while the other is loaded on buffer and sorted there.
+// keep1 and keep2 are set for outer joins, if the records of infile1 or infile2
+// with no pair are written as well
 
-void fitCase(char *infile1, char *infile2, unsigned char field, block_t *buffer, uint nmem_blocks, char *outfile, uint *nres, uint *nios) {
+template <class Key>
+void fitCase(char *infile1, char *infile2, block_t *buffer, uint nmem_blocks, bool keep1, bool keep2, blockSink *sink, uint *nres, uint *nios) {
 
     uint memSize = nmem_blocks - 1;
     uint fileSize1 = getSize(infile1);
@@ -54,73 +220,89 @@ void fitCase(char *infile1, char *infile2, unsigned char field, block_t *buffer,
     char *file1, *file2;
     // size of the file to be loaded on buffer
     uint memSize1;
+    // true if file1 is infile1
+    bool loadedFirst;
 
     // if both fit in memSize - 1 blocks, file1 is the larger one,
     // else file1 is the smaller of them
     if (fileSize1 < memSize && fileSize2 < memSize) {
-        if (fileSize1 >= fileSize2) {
-            file1 = infile1;
-            file2 = infile2;
-            memSize1 = fileSize1;
-        } else {
-            file1 = infile2;
-            file2 = infile1;
-            memSize1 = fileSize2;
-        }
+        loadedFirst = fileSize1 >= fileSize2;
     } else {
-        if (fileSize1 < fileSize2) {
-            file1 = infile1;
-            file2 = infile2;
-            memSize1 = fileSize1;
-        } else {
-            file1 = infile2;
-            file2 = infile1;
-            memSize1 = fileSize2;
-        }
+        loadedFirst = fileSize1 < fileSize2;
+    }
+    if (loadedFirst) {
+        file1 = infile1;
+        file2 = infile2;
+        memSize1 = fileSize1;
+    } else {
+        file1 = infile2;
+        file2 = infile1;
+        memSize1 = fileSize2;
     }
+    bool keepLoaded = loadedFirst ? keep1 : keep2;
+    bool keepScanned = loadedFirst ? keep2 : keep1;
 
     uint ios, dummy1, dummy2;
-    char tmpFile[] = ".mj";
+    tempSpace space;
+    if (!openSpace(space)) {
+        return;
+    }
+    char *tmpFile = tempPath(space, "mj");
 
     // sorts file2 using mergesort
-    MergeSort(file2, field, buffer, nmem_blocks, tmpFile, &dummy1, &dummy2, &ios);
+    MergeSort(file2, Key::field, buffer, nmem_blocks, tmpFile, &dummy1, &dummy2, &ios);
     (*nios) += ios;
 
     uint tmpFileSize = getSize(tmpFile);
+    beginPhase("join", 0);
 
     // the whole file1 is loaded on buffer
     (*nios) += readBlocks(file1, buffer, memSize1);
 
-    int out = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+    // pointers for convenience
+    block_t *bufferSlot = buffer + memSize - 1;
+    block_t *bufferOut = buffer + memSize;
+    emptyBlock(bufferOut);
+    (*bufferOut).blockid = 0;
+    (*bufferOut).valid = true;
 
-    // if file on buffer has valid records and the sorted one has at least one block...
-    if (sortBuffer(buffer, memSize1, field) && tmpFileSize != 0) {
-        // recordPtr pointing to the last valid record of file1 on the buffer
-        recordPtr end = newPtr(0);
+    joinOutput out;
+    out.sink = sink;
+    out.bufferOut = bufferOut;
+    out.swap = (keep1 || keep2) && loadedFirst;
+    out.nres = nres;
+
+    blockScan in;
+    openScan(in, tmpFile);
+
+    bool loaded = sortBuffer<Key>(buffer, memSize1);
+    // recordPtr pointing to the last valid record of file1 on the buffer
+    recordPtr end = newPtr(0);
+    if (loaded) {
         for (; end.block != memSize1; incr(end)) {
             if (!getRecord(buffer, end).valid) {
                 break;
             }
         }
-        decr(end);
-
-        // pointers for convenience
-        block_t *bufferIn = buffer + memSize - 1;
-        block_t *bufferOut = buffer + memSize;
-        emptyBlock(bufferOut);
-        (*bufferOut).blockid = 0;
-        (*bufferOut).valid = true;
+    }
+    decr(end);
+    // for outer joins, the records of file1 before done have been either joined
+    // or written with no pair
+    recordPtr done = newPtr(0);
 
-        int in = open(tmpFile, O_RDONLY, S_IRWXU);
+    // if file on buffer has valid records and the sorted one has at least one block...
+    if (loaded && tmpFileSize != 0) {
 
         // first block of file2 is loaded on buffer
-        (*nios) += readBlocks(in, bufferIn, 1);
+        block_t *bufferIn = nextBlock(in, bufferSlot, nios);
         // the id of the block of file2 currently on buffer
         uint currentInBlockId = 0;
 
         recordPtr ptr = newPtr(0);
+        // points to the first record of file1 with the value last joined.
+        // file1 stays on buffer, so the value is compared there in place
         recordPtr backUp;
-        record_t *lastRecordJoined = NULL;
+        bool joined = false;
 
         // becomes true when there are no records left to join
         bool joinIsOver = false;
@@ -129,7 +311,7 @@ void fitCase(char *infile1, char *infile2, unsigned char field, block_t *buffer,
 
             // for each record of the current block loaded in bufferIn...
             for (int i = 0; i < MAX_RECORDS_PER_BLOCK; i++) {
-                record_t rec = (*bufferIn).entries[i];
+                const record_t &rec = (*bufferIn).entries[i];
 
                 // if the record is invalid, the end of file2 is reached, so join is over
                 if (!rec.valid) {
@@ -140,60 +322,55 @@ void fitCase(char *infile1, char *infile2, unsigned char field, block_t *buffer,
                 // if the previous record joined from file2 has the
                 // same value as the current, sets the ptr pointer to the record
                 // of the buffer where that value is first encountered.
-                if (lastRecordJoined) {
-                    if (compareRecords(*lastRecordJoined, rec, field) == 0) {
-                        ptr = copyPtr(backUp);
-                    }
+                if (joined && Key::compare(getRecord(buffer, backUp), rec) == 0) {
+                    ptr = copyPtr(backUp);
                 }
 
-                // scans the blocks of file1, until a record with higher or equal
-                // value with the current is found.
-                while (compareRecords(getRecord(buffer, ptr), rec, field) < 0) {
-                    incr(ptr);
-                    // if ptr moves past end, all records of file1 have been
-                    // examined, so join is over
-                    if (ptr > end) {
-                        joinIsOver = true;
-                        break;
-                    }
+                // gallops over the records of file1, until a record with higher
+                // or equal value with the current is found.
+                // if ptr moves past end, all records of file1 have been
+                // examined, so join is over. for outer joins, the records
+                // galloped over that were not joined have no pair, and if
+                // file1 is over, neither have the rest of file2
+                ptr = gallopSearch<Key>(buffer, ptr, end, rec);
+                if (keepLoaded) {
+                    outputUnjoined<Key>(buffer, done, ptr, joined ? &getRecord(buffer, backUp) : NULL, out, nios);
                 }
-
-                if (joinIsOver) {
+                if (ptr > end) {
+                    if (keepScanned) {
+                        outputScanned(bufferIn, i, out, nios);
+                        outputScan(in, tmpFileSize - 1 - currentInBlockId, bufferSlot, out, nios);
+                    }
+                    joinIsOver = true;
                     break;
                 }
 
                 // if the first record (of file1) with not lower value than the
                 // current, has actually higher value than the current, continues
                 // to the next record of file2.
-                // there are no records in the smaller to join with the current
-                if (compareRecords(getRecord(buffer, ptr), rec, field) > 0) {
+                // there are no records in the smaller to join with the current,
+                // nor with the following records of file2's block that are lower
+                // than that record of file1, so they are skipped as well
+                if (Key::compare(getRecord(buffer, ptr), rec) > 0) {
+                    int last = skipLowerRecords<Key>(bufferIn, i, getRecord(buffer, ptr));
+                    for (; keepScanned && i <= last; i++) {
+                        outputPair(out, (*bufferIn).entries[i], nullRecord(), nios);
+                    }
+                    i = last;
                     continue;
                 }
 
                 // the recordPtr which points to the first record of file1
                 // with value equal to the current record of file2 is kept as backup,
-                // as well as the record itself, so that if the next record
-                // of file2 has the same value, the ptr can be set to record
-                if (!lastRecordJoined) {
-                    lastRecordJoined = (record_t*) malloc(sizeof (record_t));
-                }
-                memcpy(lastRecordJoined, &rec, sizeof (record_t));
+                // so that if the next record of file2 has the same value, the ptr
+                // can be set to that record
                 backUp = copyPtr(ptr);
+                joined = true;
 
                 // starting from the record ptr points to, all the following records
                 // with equal value to the current are written as pairs to the output.
-                while (compareRecords(getRecord(buffer, ptr), rec, field) == 0) {
-                    (*bufferOut).entries[(*bufferOut).nreserved++] = rec;
-                    (*bufferOut).entries[(*bufferOut).nreserved++] = getRecord(buffer, ptr);
-                    (*nres) += 1;
-
-                    // if the buffer block used for output becomes full, writes it to
-                    // the outfile and empties it.
-                    if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
-                        (*nios) += writeBlocks(out, bufferOut, 1);
-                        emptyBlock(bufferOut);
-                        (*bufferOut).blockid += 1;
-                    }
+                while (Key::compare(getRecord(buffer, ptr), rec) == 0) {
+                    outputPair(out, rec, getRecord(buffer, ptr), nios);
 
                     // if ptr moves past end, stops searching for records.
                     // there are no more
@@ -211,32 +388,63 @@ void fitCase(char *infile1, char *infile2, unsigned char field, block_t *buffer,
             // are examined, if there are blocks left to file2, loads
             // the next one, otherwise join is over.
             if (currentInBlockId < tmpFileSize - 1) {
-                (*nios) += readBlocks(in, bufferIn, 1);
+                bufferIn = nextBlock(in, bufferSlot, nios);
                 currentInBlockId += 1;
             } else {
                 joinIsOver = true;
             }
         }
-        if (lastRecordJoined) {
-            free(lastRecordJoined);
-        }
-        // if the are pairs left in the buffer, writes them to the outfile
-        if ((*bufferOut).nreserved != 0) {
-            (*nios) += writeBlocks(out, bufferOut, 1);
+        // for outer joins, the records of file1 left have no pair
+        if (keepLoaded) {
+            outputUnjoined<Key>(buffer, done, end + 1, joined ? &getRecord(buffer, backUp) : NULL, out, nios);
         }
-        close(in);
+    } else if (loaded && keepLoaded) {
+        outputUnjoined<Key>(buffer, done, end + 1, NULL, out, nios);
+    } else if (keepScanned) {
+        outputScan(in, tmpFileSize, bufferSlot, out, nios);
     }
+    // if the are pairs left in the buffer, writes them to the outfile
+    if ((*bufferOut).nreserved != 0) {
+        (*nios) += putBlock(sink, bufferOut);
+    }
+    closeScan(in);
     remove(tmpFile);
-    close(out);
+    free(tmpFile);
+    closeSpace(space);
 }
 
-void MergeJoin(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+// for outer joins. like outputUnjoined, for a block of the smaller relation of
+// the external case. doneBlock is the id of the block done is on. the records
+// of the blocks before id that are after done have all been joined
 
-    if (nmem_blocks < 3) {
-        printf("At least 3 blocks are required.");
+template <class Key>
+void outputUnjoined(block_t *block, uint id, uint &doneBlock, recordPtr &done, recordPtr to, const record_t *lastJoined, joinOutput &out, uint *nios) {
+    if (id < doneBlock) {
         return;
     }
-    
+    if (id > doneBlock) {
+        doneBlock = id;
+        done = newPtr(0);
+    }
+    outputUnjoined<Key>(block, done, to, lastJoined, out, nios);
+}
+
+// for outer joins. writes the valid records of a file with no pair
+
+void outputFile(char *filename, block_t *bufferSlot, joinOutput &out, uint *nios) {
+    blockScan in;
+    if (openScan(in, filename)) {
+        outputScan(in, in.size, bufferSlot, out, nios);
+        closeScan(in);
+    }
+}
+
+// merge joins infile1 and infile2 on the field of the key policy.
+// keep1 and keep2 are set for outer joins, like in fitCase
+
+template <class Key>
+void mergeJoin(char *infile1, char *infile2, block_t *buffer, unsigned int nmem_blocks, bool keep1, bool keep2, blockSink *sink, unsigned int *nres, unsigned int *nios) {
+
     emptyBuffer(buffer, nmem_blocks);
 
     // memSize blocks will be used for joining while the other is used for output
@@ -247,52 +455,83 @@ void MergeJoin(char *infile1, char *infile2, unsigned char field, block_t *buffe
     *nres = 0;
     *nios = 0;
 
-    if (fileSize1 != 0 && fileSize2 != 0) {
+    // pointers for convenience
+    block_t *bufferSlot = buffer + memSize - 1;
+    block_t *bufferOut = buffer + memSize;
+
+    joinOutput out;
+    out.sink = sink;
+    out.bufferOut = bufferOut;
+    out.swap = false;
+    out.nres = nres;
+
+    if (fileSize1 == 0 || fileSize2 == 0) {
+        // for outer joins, the records of the file that is not empty have no pair
+        if ((fileSize1 != 0 && keep1) || (fileSize2 != 0 && keep2)) {
+            beginPhase("join", 0);
+            emptyBlock(bufferOut);
+            (*bufferOut).blockid = 0;
+            (*bufferOut).valid = true;
+            out.swap = fileSize1 == 0;
+            outputFile(fileSize1 != 0 ? infile1 : infile2, bufferSlot, out, nios);
+            if ((*bufferOut).nreserved != 0) {
+                (*nios) += putBlock(sink, bufferOut);
+            }
+        }
+    } else {
         // if at least one of the two files fits in memSize - 1 blocks, calls fitCase
         if ((fileSize1 < memSize || fileSize2 < memSize)) {
-            fitCase(infile1, infile2, field, buffer, nmem_blocks, outfile, nres, nios);
+            fitCase<Key>(infile1, infile2, buffer, nmem_blocks, keep1, keep2, sink, nres, nios);
         } else {
-            char tmpFile1[] = ".mj1";
-            char tmpFile2[] = ".mj2";
+            tempSpace space;
+            if (!openSpace(space)) {
+                return;
+            }
+            char *tmpName1 = tempPath(space, "mj1");
+            char *tmpName2 = tempPath(space, "mj2");
+            char *tmpFile1 = tmpName1;
+            char *tmpFile2 = tmpName2;
 
             // each one of the infiles is sorted using MergeSort.
-            // the files produced (".mj1" and ".mj2") are 100% utilised (with the possible
+            // the files produced ("mj1" and "mj2") are 100% utilised (with the possible
             // exception of the last block of each) so no measures for invalid blocks need
             // to be taken
             uint dummy1, dummy2, ios;
-            MergeSort(infile1, field, buffer, nmem_blocks, tmpFile1, &dummy1, &dummy2, &ios);
+            MergeSort(infile1, Key::field, buffer, nmem_blocks, tmpFile1, &dummy1, &dummy2, &ios);
             (*nios) += ios;
-            MergeSort(infile2, field, buffer, nmem_blocks, tmpFile2, &dummy1, &dummy2, &ios);
+            MergeSort(infile2, Key::field, buffer, nmem_blocks, tmpFile2, &dummy1, &dummy2, &ios);
             (*nios) += ios;
-
-            int out = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+            beginPhase("join", 0);
 
             fileSize1 = getSize(tmpFile1);
             fileSize2 = getSize(tmpFile2);
 
+            emptyBlock(bufferOut);
+            (*bufferOut).blockid = 0;
+            (*bufferOut).valid = true;
+
             // if non of the sorted files are empty...
             if (fileSize1 != 0 && fileSize2 != 0) {
                 // the first file is considered to be the smaller one.
                 // if that's not the case, swaps them
+                bool smallerFirst = true;
                 if (fileSize1 > fileSize2) {
                     uint tmp = fileSize1;
                     fileSize1 = fileSize2;
                     fileSize2 = tmp;
-                    tmpFile1[3] = '2';
-                    tmpFile2[3] = '1';
+                    tmpFile1 = tmpName2;
+                    tmpFile2 = tmpName1;
+                    smallerFirst = false;
                 }
+                bool keepSmaller = smallerFirst ? keep1 : keep2;
+                bool keepBigger = smallerFirst ? keep2 : keep1;
+                out.swap = (keep1 || keep2) && smallerFirst;
 
                 // of the memSize available blocks, memSize - 1 are given to the smaller
                 // relation and 1 to the big relation
-                int in1 = open(tmpFile1, O_RDONLY, S_IRWXU);
-                int in2 = open(tmpFile2, O_RDONLY, S_IRWXU);
-
-                // pointers for convenience
-                block_t *bufferIn = buffer + memSize - 1;
-                block_t *bufferOut = buffer + memSize;
-                emptyBlock(bufferOut);
-                (*bufferOut).blockid = 0;
-                (*bufferOut).valid = true;
+                int in1 = openFile(tmpFile1, O_RDONLY);
+                blockScan in2;
+                openScan(in2, tmpFile2);
 
                 // the number of blocks in buffer given to the smaller relation
                 uint memSize1;
@@ -302,34 +541,47 @@ void MergeJoin(char *infile1, char *infile2, unsigned char field, block_t *buffe
                     memSize1 = memSize - 1;
                 }
 
-                // the memSize1 first blocks of the smaller and the first
+                // the blocks of the smaller relation are pinned through a buffer pool
+                // over the memSize1 first blocks of the buffer, so that blocks accessed
+                // again (when a group of equal values is joined with more than one
+                // record of the bigger relation) are not reread while they are still there
+                bufferPool pool;
+                initPool(pool, buffer, memSize1);
+
+                // the first block of the smaller and the first
                 // block of the bigger are loaded on buffer
-                (*nios) += readBlocks(in1, buffer, memSize1);
-                (*nios) += readBlocks(in2, bufferIn, 1);
+                uint blockId = 0;
+                block_t *block = pinBlock(pool, in1, blockId, nios);
+                block_t *bufferIn = nextBlock(in2, bufferSlot, nios);
 
-                // the lowest block id of the blocks of the smaller file currenty loaded on buffer
-                uint firstBlockId = 0;
-                // the highest block id of the blocks of the smaller file currently loaded on buffer
-                uint lastBlockId = memSize1 - 1;
                 // the block id of the current block loaded from the bigger file
                 uint currentInBlockId = 0;
 
-                // pointer to a record of the smaller relation currently on buffer
-                // initialises to point to the very first record of the file
+                // pointer to a record of the block of the smaller relation currently
+                // pinned (block is always 0). it may point one past the last record of
+                // the block, when all of its records have been joined
                 recordPtr ptr = newPtr(0);
 
                 blockToLoad backUp;
                 backUp.lastValueJoined = NULL;
 
+                // for outer joins, the records of the smaller relation before
+                // done, on block doneBlock, have been either joined or written
+                // with no pair
+                uint doneBlock = 0;
+                recordPtr done = newPtr(0);
+
                 // becomes true when there are no records left to join
                 bool joinIsOver = false;
+                // becomes true when the smaller relation is over
+                bool smallerIsOver = false;
 
                 while (!joinIsOver) {
 
                     // for each record of the current block loaded in bufferIn (this is the block
                     // the bigger relation uses)...
                     for (int i = 0; i < MAX_RECORDS_PER_BLOCK; i++) {
-                        record_t rec = (*bufferIn).entries[i];
+                        const record_t &rec = (*bufferIn).entries[i];
                         // if an invalid record is found, that means the end of the bigger
                         // relation is reached, so sets joinIsOver as true and breaks the loop
                         if (!rec.valid) {
@@ -338,73 +590,91 @@ void MergeJoin(char *infile1, char *infile2, unsigned char field, block_t *buffe
                         }
                         // if the previous record joined from the bigger relation has the
                         // same value as the current, sets the ptr pointer to the block
-                        // where that value is first encountered. if that block is no longer
-                        // in the buffer, reloads it as well as the others after it, if they
-                        // were removed as well
+                        // where that value is first encountered. the pool reads that block
+                        // again only if it is no longer on buffer
                         if (backUp.lastValueJoined) {
-                            if (compareRecords(rec, *backUp.lastValueJoined, field) == 0) {
-                                if (backUp.blockId < firstBlockId) {
-                                    uint blocksToLoad;
-                                    if (firstBlockId - backUp.blockId <= memSize1) {
-                                        blocksToLoad = firstBlockId - backUp.blockId;
-                                    } else {
-                                        blocksToLoad = memSize1;
-                                    }
-                                    for (uint i = 0; i < blocksToLoad; i++) {
-                                        (*nios) += preadBlocks(in1, buffer + (backUp.blockId + i) % memSize1, backUp.blockId + i, 1);
-                                    }
-                                    firstBlockId = backUp.blockId;
-                                    lastBlockId = firstBlockId + memSize1 - 1;
+                            if (Key::compare(rec, *backUp.lastValueJoined) == 0) {
+                                if (blockId != backUp.blockId) {
+                                    block = moveToBlock(pool, in1, block, backUp.blockId, nios);
+                                    blockId = backUp.blockId;
                                 }
-                                ptr.block = backUp.blockId % memSize1;
                                 ptr.record = 0;
                             }
                         }
 
-                        // scans the blocks of the smaller relation currently loaded, until
-                        // a record with higher or equal value with the current is found.
-                        // if needed, blocks from the smaller relation are loaded 
-                        while (compareRecords(getRecord(buffer, ptr), rec, field) < 0) {
-                            // ptr increases by one
-                            incr(ptr);
-                            // if the increment caused ptr to change block, makes sure
-                            // that the ptr stays in just the memSize1 first blocks of the buffer
-                            if (ptr.record == 0) {
-                                ptr.block = ptr.block % memSize1;
-                                // if the ptr after the block change has completed a full circle
-                                // of the blocks currently loaded, if there are any more blocks
-                                // left to the small relation, load the next one.
-                                // if there are no blocks left, join is over, because the last record
-                                // of the smaller relation has lower value than the current record
-                                // of the bigger, and consiquently from the rest as well
-                                if (ptr.block == firstBlockId % memSize1) {
-                                    if (lastBlockId < fileSize1 - 1) {
-                                        (*nios) += preadBlocks(in1, buffer + firstBlockId % memSize1, lastBlockId + 1, 1);
-                                        firstBlockId += 1;
-                                        lastBlockId += 1;
-                                    } else {
-                                        joinIsOver = true;
-                                        break;
-                                    }
+                        // scans the blocks of the smaller relation, until a record with
+                        // higher or equal value with the current is found.
+                        // if the last record of the block is lower than the current, the
+                        // next block that may hold it is searched for in the rest of
+                        // the smaller relation, otherwise the record is searched for by
+                        // galloping in the block
+                        while (true) {
+                            // if the block has no records, the end of the smaller
+                            // relation has been reached, so join is over
+                            if ((*block).nreserved == 0) {
+                                joinIsOver = true;
+                                smallerIsOver = true;
+                                break;
+                            }
+                            if (!blockIsLower<Key>(block, rec)) {
+                                ptr = gallopSearch<Key>(block, ptr, newPtr((*block).nreserved - 1), rec);
+                                if (keepSmaller) {
+                                    outputUnjoined<Key>(block, blockId, doneBlock, done, ptr, backUp.lastValueJoined, out, nios);
                                 }
+                                break;
+                            }
+                            // for outer joins, the blocks of the smaller relation
+                            // cannot be seeked over, because their records that
+                            // were not joined are written with no pair. so the
+                            // rest of the block is written and the next one is read
+                            if (keepSmaller) {
+                                outputUnjoined<Key>(block, blockId, doneBlock, done, newPtr((*block).nreserved), backUp.lastValueJoined, out, nios);
+                                if (blockId == fileSize1 - 1) {
+                                    unpinBlock(pool, block);
+                                    joinIsOver = true;
+                                    smallerIsOver = true;
+                                    break;
+                                }
+                                blockId += 1;
+                                block = moveToBlock(pool, in1, block, blockId, nios);
+                                ptr.record = 0;
+                                continue;
                             }
-                            // if the record ptr points to is invalid, the end of the
-                            // smaller relation has been reached. for the same reason
-                            // as above, join is over.
-                            if (!getRecord(buffer, ptr).valid) {
+                            // if there is no such block, join is over, because the last record
+                            // of the smaller relation has lower value than the current record
+                            // of the bigger, and consiquently from the rest as well
+                            unpinBlock(pool, block);
+                            blockId = seekBlock<Key>(pool, in1, fileSize1, blockId, rec, nios);
+                            if (blockId == fileSize1) {
                                 joinIsOver = true;
+                                smallerIsOver = true;
                                 break;
                             }
+                            block = pinBlock(pool, in1, blockId, nios);
+                            ptr.record = 0;
                         }
                         if (joinIsOver) {
+                            // for outer joins, the records of the bigger relation
+                            // left have no pair
+                            if (keepBigger) {
+                                outputScanned(bufferIn, i, out, nios);
+                                outputScan(in2, fileSize2 - 1 - currentInBlockId, bufferSlot, out, nios);
+                            }
                             break;
                         }
                         // if the first record (of the smaller relation) with
                         // not lower value than the current, has actually higher value
                         // than the current, continues to the next record of the
                         // bigger relation. there are no records in the smaller to join
-                        // with the current
-                        if (compareRecords(getRecord(buffer, ptr), rec, field) > 0) {
+                        // with the current, nor with the following records of the bigger
+                        // relation's block that are lower than that record, so they are
+                        // skipped as well
+                        if (Key::compare(getRecord(block, ptr), rec) > 0) {
+                            int last = skipLowerRecords<Key>(bufferIn, i, getRecord(block, ptr));
+                            for (; keepBigger && i <= last; i++) {
+                                outputPair(out, (*bufferIn).entries[i], nullRecord(), nios);
+                            }
+                            i = last;
                             continue;
                         }
 
@@ -415,53 +685,30 @@ void MergeJoin(char *infile1, char *infile2, unsigned char field, block_t *buffe
                         if (!backUp.lastValueJoined) {
                             backUp.lastValueJoined = (record_t*) malloc(sizeof (record_t));
                         }
-                        record_t tmp = getRecord(buffer, ptr);
-                        memcpy(backUp.lastValueJoined, &tmp, sizeof (record_t));
-                        if (ptr.block >= firstBlockId % memSize1) {
-                            backUp.blockId = firstBlockId + ptr.block - firstBlockId % memSize1;
-                        } else {
-                            backUp.blockId = firstBlockId + ptr.block + memSize1 - firstBlockId % memSize1;
-                        }
+                        // the block may be evicted from the pool before the value
+                        // is needed again, so this is the one record copied per
+                        // group of equal values
+                        *backUp.lastValueJoined = getRecord(block, ptr);
+                        backUp.blockId = blockId;
 
                         // starting from the record ptr points to, all the following records
                         // with equal value to the current are written as pairs to the output.
-                        while (compareRecords(getRecord(buffer, ptr), rec, field) == 0) {
-                            (*bufferOut).entries[(*bufferOut).nreserved++] = rec;
-                            (*bufferOut).entries[(*bufferOut).nreserved++] = getRecord(buffer, ptr);
-                            (*nres) += 1;
-
-                            // if the buffer block used for output becomes full, writes it to
-                            // the outfile and empties it.
-                            if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
-                                (*nios) += writeBlocks(out, bufferOut, 1);
-                                emptyBlock(bufferOut);
-                                (*bufferOut).blockid += 1;
-                            }
+                        while (Key::compare(getRecord(block, ptr), rec) == 0) {
+                            outputPair(out, rec, getRecord(block, ptr), nios);
 
-                            incr(ptr);
-                            if (ptr.record == 0) {
-                                // makes sure the ptr doesn't exceed the first memSize1 blocks.
-                                ptr.block = ptr.block % memSize1;
-                                // if needed, loads next block from smaller relation
-                                if (ptr.block == firstBlockId % memSize1) {
-                                    if (lastBlockId < fileSize1 - 1) {
-                                        (*nios) += preadBlocks(in1, buffer + firstBlockId % memSize1, lastBlockId + 1, 1);
-                                        firstBlockId += 1;
-                                        lastBlockId += 1;
-                                    } else {
-                                        if (ptr.block == 0) {
-                                            ptr.block = memSize1 - 1;
-                                        } else {
-                                            ptr.block -= 1;
-                                        }
-                                        ptr.record = MAX_RECORDS_PER_BLOCK - 1;
-                                        break;
-                                    }
+                            // if the end of the block is reached, moves to the next one.
+                            // if there is none, ptr stays one past the last record
+                            ptr.record += 1;
+                            if (ptr.record == (int) (*block).nreserved) {
+                                if (blockId == fileSize1 - 1) {
+                                    break;
+                                }
+                                blockId += 1;
+                                block = moveToBlock(pool, in1, block, blockId, nios);
+                                ptr.record = 0;
+                                if ((*block).nreserved == 0) {
+                                    break;
                                 }
-                            }
-                            if (!getRecord(buffer, ptr).valid) {
-                                decr(ptr);
-                                break;
                             }
                         }
                     }
@@ -472,25 +719,755 @@ void MergeJoin(char *infile1, char *infile2, unsigned char field, block_t *buffe
                     // are examined, if there are blocks left to the bigger relation, loads
                     // the next one, otherwise join is over.
                     if (currentInBlockId < fileSize2 - 1) {
-                        (*nios) += readBlocks(in2, bufferIn, 1);
+                        bufferIn = nextBlock(in2, bufferSlot, nios);
                         currentInBlockId += 1;
                     } else {
                         joinIsOver = true;
                     }
                 }
+                // for outer joins, if the bigger relation is over first, the
+                // records of the smaller left have no pair
+                if (keepSmaller && !smallerIsOver) {
+                    outputUnjoined<Key>(block, blockId, doneBlock, done, newPtr((*block).nreserved), backUp.lastValueJoined, out, nios);
+                    for (blockId += 1; blockId < fileSize1; blockId++) {
+                        block = moveToBlock(pool, in1, block, blockId, nios);
+                        outputUnjoined<Key>(block, blockId, doneBlock, done, newPtr((*block).nreserved), backUp.lastValueJoined, out, nios);
+                    }
+                }
+                destroyPool(pool);
                 if (backUp.lastValueJoined) {
                     free(backUp.lastValueJoined);
                 }
                 // if the are pairs left in the buffer, writes them to the outfile
                 if ((*bufferOut).nreserved != 0) {
-                    (*nios) += writeBlocks(out, bufferOut, 1);
+                    (*nios) += putBlock(sink, bufferOut);
+                }
+                closeFile(in1);
+                closeScan(in2);
+            } else if ((fileSize1 != 0 && keep1) || (fileSize2 != 0 && keep2)) {
+                // for outer joins, the records of the sorted file that is not
+                // empty have no pair
+                out.swap = fileSize1 == 0;
+                outputFile(fileSize1 != 0 ? tmpFile1 : tmpFile2, bufferSlot, out, nios);
+                if ((*bufferOut).nreserved != 0) {
+                    (*nios) += putBlock(sink, bufferOut);
+                }
+            }
+            remove(tmpName1);
+            remove(tmpName2);
+            free(tmpName1);
+            free(tmpName2);
+            closeSpace(space);
+        }
+    }
+    endPhase();
+}
+
+// a sorted file read through a buffer pool, with one of its blocks pinned at a
+// time. its records are found by their position in the file, which is compact,
+// so the records of all its blocks but the last are MAX_RECORDS_PER_BLOCK
+
+typedef struct {
+    bufferPool *pool;
+    int in;
+    uint fileSize;
+    block_t *block;
+    uint blockId;
+} pooledFile;
+
+void openPooled(pooledFile &file, bufferPool &pool, char *filename, uint *nios) {
+    file.pool = &pool;
+    file.in = openFile(filename, O_RDONLY);
+    file.fileSize = getSize(filename);
+    file.block = NULL;
+    file.blockId = 0;
+    if (file.fileSize != 0) {
+        file.block = pinBlock(pool, file.in, 0, nios);
+    }
+}
+
+void closePooled(pooledFile &file) {
+    if (file.block) {
+        unpinBlock(*file.pool, file.block);
+    }
+    closeFile(file.in);
+}
+
+// returns the record at position pos of file, or NULL if there is none. it
+// stays on buffer until the next call
+
+inline const record_t *pooledRecord(pooledFile &file, uint pos, uint *nios) {
+    uint id = pos / MAX_RECORDS_PER_BLOCK;
+    if (id >= file.fileSize) {
+        return NULL;
+    }
+    if (id != file.blockId) {
+        file.block = moveToBlock(*file.pool, file.in, file.block, id, nios);
+        file.blockId = id;
+    }
+    uint record = pos % MAX_RECORDS_PER_BLOCK;
+    if (!(*file.block).valid || record >= (*file.block).nreserved) {
+        return NULL;
+    }
+    return (*file.block).entries + record;
+}
+
+// moves pos forward to the first record of file not lower than rec. the
+// records are galloped over, and the blocks are seeked over like in the
+// external case of mergeJoin. pos is moved past the end if there is none
+
+template <class Key>
+void seekRecord(pooledFile &file, uint &pos, const record_t &rec, uint *nios) {
+    const record_t *first = pooledRecord(file, pos, nios);
+    if (!first || Key::compare(*first, rec) >= 0) {
+        return;
+    }
+    uint from = pos % MAX_RECORDS_PER_BLOCK;
+    if (blockIsLower<Key>(file.block, rec)) {
+        unpinBlock(*file.pool, file.block);
+        uint id = seekBlock<Key>(*file.pool, file.in, file.fileSize, file.blockId, rec, nios);
+        if (id == file.fileSize) {
+            file.block = pinBlock(*file.pool, file.in, file.blockId, nios);
+            pos = file.fileSize * MAX_RECORDS_PER_BLOCK;
+            return;
+        }
+        file.block = pinBlock(*file.pool, file.in, id, nios);
+        file.blockId = id;
+        from = 0;
+    }
+    recordPtr start = gallopSearch<Key>(file.block, newPtr(from), newPtr((*file.block).nreserved - 1), rec);
+    pos = file.blockId * MAX_RECORDS_PER_BLOCK + getOffset(start);
+}
+
+// the window of a band join over the smaller relation, sorted on num. the
+// relation is either loaded on buffer, where it has count records, or read
+// through a pool
+
+typedef struct {
+    block_t *buffer;
+    uint count;
+    bool pooled;
+    pooledFile file;
+    // the position of the first record of the window
+    uint start;
+} bandWindow;
+
+// returns the record at position pos of the smaller relation, or NULL if there
+// is none. it stays on buffer until the next call
+
+inline const record_t *windowRecord(bandWindow &window, uint pos, uint *nios) {
+    if (window.pooled) {
+        return pooledRecord(window.file, pos, nios);
+    }
+    return pos < window.count ? &getRecord(window.buffer, newPtr(pos)) : NULL;
+}
+
+// moves the start of the window to the first record with num not lower than lower
+
+void advanceWindow(bandWindow &window, uint lower, uint *nios) {
+    record_t bound;
+    bound.num = lower;
+    if (window.pooled) {
+        seekRecord<NumKey>(window.file, window.start, bound, nios);
+    } else if (window.start < window.count) {
+        window.start = getOffset(gallopSearch<NumKey>(window.buffer, newPtr(window.start), newPtr(window.count - 1), bound));
+    }
+}
+
+// band joins infile1 and infile2: each record of the bigger relation, sorted on
+// num, is joined with the window of records of the smaller relation, sorted on
+// num as well, that are within delta of it. as the bigger relation is scanned,
+// the window only moves forward, so each pass over it is one merge
+
+void bandJoin(char *infile1, char *infile2, uint delta, block_t *buffer, uint nmem_blocks, blockSink *sink, uint *nres, uint *nios) {
+
+    emptyBuffer(buffer, nmem_blocks);
+
+    uint memSize = nmem_blocks - 1;
+    uint fileSize1 = getSize(infile1);
+    uint fileSize2 = getSize(infile2);
+
+    *nres = 0;
+    *nios = 0;
+
+    if (fileSize1 == 0 || fileSize2 == 0) {
+        return;
+    }
+
+    // the smaller relation is the one the window is kept on
+    bool windowFirst = fileSize1 <= fileSize2;
+    char *windowFile = windowFirst ? infile1 : infile2;
+    char *scannedFile = windowFirst ? infile2 : infile1;
+    uint windowSize = windowFirst ? fileSize1 : fileSize2;
+
+    tempSpace space;
+    if (!openSpace(space)) {
+        return;
+    }
+    char *tmpFile1 = tempPath(space, "mj1");
+    char *tmpFile2 = tempPath(space, "mj2");
+    uint dummy1, dummy2, ios;
+    MergeSort(scannedFile, 1, buffer, nmem_blocks, tmpFile2, &dummy1, &dummy2, &ios);
+    (*nios) += ios;
+
+    // pointers for convenience
+    block_t *bufferSlot = buffer + memSize - 1;
+    block_t *bufferOut = buffer + memSize;
+
+    bandWindow window;
+    window.start = 0;
+    window.pooled = false;
+    bufferPool pool;
+    bool windowIsEmpty;
+    if (windowSize < memSize) {
+        // if the smaller relation fits in memSize - 1 blocks, it is loaded
+        // on buffer and sorted there
+        beginPhase("run generation", 1);
+        (*nios) += readBlocks(windowFile, buffer, windowSize);
+        window.buffer = buffer;
+        window.count = 0;
+        if (sortBuffer<NumKey>(buffer, windowSize)) {
+            while (window.count < windowSize * MAX_RECORDS_PER_BLOCK && getRecord(buffer, newPtr(window.count)).valid) {
+                window.count += 1;
+            }
+        }
+        windowIsEmpty = window.count == 0;
+    } else {
+        // otherwise it is sorted using MergeSort, and its blocks are pinned
+        // through a buffer pool over memSize - 1 blocks, so that the blocks
+        // of the window are not reread while they are still there
+        MergeSort(windowFile, 1, buffer, nmem_blocks, tmpFile1, &dummy1, &dummy2, &ios);
+        (*nios) += ios;
+        initPool(pool, buffer, memSize - 1);
+        openPooled(window.file, pool, tmpFile1, nios);
+        window.pooled = true;
+        windowIsEmpty = window.file.fileSize == 0;
+    }
+    beginPhase("join", 0);
+
+    emptyBlock(bufferOut);
+    (*bufferOut).blockid = 0;
+    (*bufferOut).valid = true;
+
+    joinOutput out;
+    out.sink = sink;
+    out.bufferOut = bufferOut;
+    out.swap = windowFirst;
+    out.nres = nres;
+
+    blockScan in;
+    openScan(in, tmpFile2);
+    // becomes true when there are no records left to join
+    bool joinIsOver = windowIsEmpty;
+    for (uint b = 0; b < in.size && !joinIsOver; b++) {
+        block_t *bufferIn = nextBlock(in, bufferSlot, nios);
+        for (int i = 0; i < MAX_RECORDS_PER_BLOCK; i++) {
+            const record_t &rec = (*bufferIn).entries[i];
+            // if the record is invalid, the end of the bigger relation is reached
+            if (!rec.valid) {
+                joinIsOver = true;
+                break;
+            }
+            uint lower = rec.num > delta ? rec.num - delta : 0;
+            uint upper = rec.num < UINT_MAX - delta ? rec.num + delta : UINT_MAX;
+
+            // the records of the window lower than the band of the current
+            // record are lower than the bands of the following ones as well,
+            // so the start of the window is moved past them. if no record is
+            // left, the following records have no pairs, so join is over
+            advanceWindow(window, lower, nios);
+            const record_t *other = windowRecord(window, window.start, nios);
+            if (!other) {
+                joinIsOver = true;
+                break;
+            }
+            for (uint pos = window.start; other && (*other).num <= upper; other = windowRecord(window, ++pos, nios)) {
+                outputPair(out, rec, *other, nios);
+            }
+        }
+    }
+    closeScan(in);
+
+    // if the are pairs left in the buffer, writes them to the outfile
+    if ((*bufferOut).nreserved != 0) {
+        (*nios) += putBlock(sink, bufferOut);
+    }
+    if (window.pooled) {
+        closePooled(window.file);
+        destroyPool(pool);
+    }
+    remove(tmpFile1);
+    remove(tmpFile2);
+    free(tmpFile1);
+    free(tmpFile2);
+    closeSpace(space);
+    endPhase();
+}
+
+/*
+ * files: the sorted inputs, read through a pool
+ * ninputs: number of inputs
+ * start, end: the group of each input, from start up to (not including) end
+ * tuple: holds the records of the tuple being output
+ * out: the output block
+ *
+ * writes the cross product of the groups to the output, one tuple of ninputs
+ * records at a time, with the record of the first input first. the positions
+ * of the tuple change like the digits of a counter, the last input's fastest,
+ * so a record is only fetched again when its position changes
+ */
+void outputTuples(pooledFile *files, uint ninputs, uint *start, uint *end, record_t *tuple, blockSink *sink, block_t *bufferOut, uint *nres, uint *nios) {
+    uint *positions = (uint*) malloc(ninputs * sizeof (uint));
+    for (uint k = 0; k < ninputs; k++) {
+        positions[k] = start[k];
+        tuple[k] = *pooledRecord(files[k], positions[k], nios);
+    }
+    while (true) {
+        // a tuple is never split between two blocks
+        if ((*bufferOut).nreserved + ninputs > MAX_RECORDS_PER_BLOCK) {
+            (*nios) += putBlock(sink, bufferOut);
+            emptyBlock(bufferOut);
+            (*bufferOut).blockid += 1;
+        }
+        for (uint k = 0; k < ninputs; k++) {
+            (*bufferOut).entries[(*bufferOut).nreserved++] = tuple[k];
+        }
+        (*nres) += 1;
+
+        // moves to the next tuple. if the position of an input passes the end
+        // of its group, it goes back to its start and the previous input moves
+        int k = ninputs - 1;
+        for (; k >= 0; k--) {
+            positions[k] += 1;
+            if (positions[k] < end[k]) {
+                tuple[k] = *pooledRecord(files[k], positions[k], nios);
+                break;
+            }
+            positions[k] = start[k];
+            tuple[k] = *pooledRecord(files[k], positions[k], nios);
+        }
+        if (k < 0) {
+            break;
+        }
+    }
+    free(positions);
+}
+
+// merge joins ninputs files on the field of the key policy. each one is sorted
+// once and then all of them are merged together: the inputs whose current
+// record is lower than the highest are moved forward to it, and when all of
+// them are on the same value the cross product of their groups is output
+
+template <class Key>
+void multiMergeJoin(char **infiles, uint ninputs, block_t *buffer, uint nmem_blocks, blockSink *sink, uint *nres, uint *nios) {
+
+    emptyBuffer(buffer, nmem_blocks);
+
+    uint memSize = nmem_blocks - 1;
+    *nres = 0;
+    *nios = 0;
+
+    // each input is sorted using MergeSort
+    tempSpace space;
+    if (!openSpace(space)) {
+        return;
+    }
+    char **sortedFiles = (char**) malloc(ninputs * sizeof (char*));
+    for (uint k = 0; k < ninputs; k++) {
+        uint dummy1, dummy2, ios;
+        char name[16];
+        sprintf(name, "nj_%u", k);
+        sortedFiles[k] = tempPath(space, name);
+        MergeSort(infiles[k], Key::field, buffer, nmem_blocks, sortedFiles[k], &dummy1, &dummy2, &ios);
+        (*nios) += ios;
+    }
+    beginPhase("join", 0);
+
+    // the sorted inputs are read through a buffer pool over memSize blocks.
+    // each input has one block pinned at a time, so blocks of groups that are
+    // output more than once are not reread while they are still there
+    bufferPool pool;
+    initPool(pool, buffer, memSize);
+    block_t *bufferOut = buffer + memSize;
+    emptyBlock(bufferOut);
+    (*bufferOut).blockid = 0;
+    (*bufferOut).valid = true;
+
+    pooledFile *files = (pooledFile*) malloc(ninputs * sizeof (pooledFile));
+    // the current position of each input and the end of its group
+    uint *positions = (uint*) malloc(ninputs * sizeof (uint));
+    uint *ends = (uint*) malloc(ninputs * sizeof (uint));
+    record_t *tuple = (record_t*) malloc(ninputs * sizeof (record_t));
+    for (uint k = 0; k < ninputs; k++) {
+        openPooled(files[k], pool, sortedFiles[k], nios);
+        positions[k] = 0;
+    }
+
+    // becomes true when an input is over, so there are no tuples left
+    bool joinIsOver = false;
+    record_t highest;
+    while (!joinIsOver) {
+        // finds the highest of the current records
+        for (uint k = 0; k < ninputs; k++) {
+            const record_t *record = pooledRecord(files[k], positions[k], nios);
+            if (!record) {
+                joinIsOver = true;
+                break;
+            }
+            if (k == 0 || Key::compare(*record, highest) > 0) {
+                highest = *record;
+            }
+        }
+        if (joinIsOver) {
+            break;
+        }
+
+        // moves the inputs that are lower forward. if one of them moves past
+        // the highest, the highest is found again
+        bool equal = true;
+        for (uint k = 0; k < ninputs && !joinIsOver; k++) {
+            seekRecord<Key>(files[k], positions[k], highest, nios);
+            const record_t *record = pooledRecord(files[k], positions[k], nios);
+            if (!record) {
+                joinIsOver = true;
+            } else if (Key::compare(*record, highest) != 0) {
+                equal = false;
+            }
+        }
+        if (joinIsOver || !equal) {
+            continue;
+        }
+
+        // all the inputs are on the same value, so finds the end of the group
+        // of each one, outputs their cross product and moves past them
+        for (uint k = 0; k < ninputs; k++) {
+            const record_t *record;
+            ends[k] = positions[k] + 1;
+            while ((record = pooledRecord(files[k], ends[k], nios)) && Key::compare(*record, highest) == 0) {
+                ends[k] += 1;
+            }
+        }
+        outputTuples(files, ninputs, positions, ends, tuple, sink, bufferOut, nres, nios);
+        for (uint k = 0; k < ninputs; k++) {
+            positions[k] = ends[k];
+        }
+    }
+
+    // if there are tuples left in the buffer, writes them to the outfile
+    if ((*bufferOut).nreserved != 0) {
+        (*nios) += putBlock(sink, bufferOut);
+    }
+    for (uint k = 0; k < ninputs; k++) {
+        closePooled(files[k]);
+        remove(sortedFiles[k]);
+        free(sortedFiles[k]);
+    }
+    destroyPool(pool);
+    closeSpace(space);
+    free(sortedFiles);
+    free(files);
+    free(positions);
+    free(ends);
+    free(tuple);
+    endPhase();
+}
+
+// state of a merge join iterator
+
+typedef struct {
+    blockIterator *left;
+    blockIterator *right;
+    // the current block of each input and the position of its next record
+    block_t *leftBlock;
+    uint leftPos;
+    block_t *rightBlock;
+    uint rightPos;
+    // the group of records of left with equal values, that is joined with the
+    // records of right with that value. the first groupBlocks - 1 blocks of the
+    // group are kept on groupBuffer, the rest are spilled to spillFile through
+    // the last block of groupBuffer
+    block_t *groupBuffer;
+    uint groupBlocks;
+    uint groupSize;
+    // the record of the group to be joined next with the current record of right
+    uint groupPos;
+    tempSpace space;
+    char *spillFile;
+    int spill;
+    // the block of spillFile loaded on the last block of groupBuffer, or -1
+    int spillLoaded;
+    block_t *bufferOut;
+    uint *nres;
+} mergeJoinState;
+
+// returns the i-th record of the group, loading its block if it is spilled
+
+inline const record_t &groupRecord(mergeJoinState &state, uint i, uint *nios) {
+    uint memBlocks = state.groupBlocks - 1;
+    uint block = i / MAX_RECORDS_PER_BLOCK;
+    if (block < memBlocks) {
+        return state.groupBuffer[block].entries[i % MAX_RECORDS_PER_BLOCK];
+    }
+    block_t *slot = state.groupBuffer + memBlocks;
+    if (state.spillLoaded != (int) (block - memBlocks)) {
+        (*nios) += preadBlocks(state.spill, slot, block - memBlocks, 1);
+        state.spillLoaded = block - memBlocks;
+    }
+    return (*slot).entries[i % MAX_RECORDS_PER_BLOCK];
+}
+
+// copies the records of left with the same value as its current record to the group
+
+template <class Key>
+void loadGroup(mergeJoinState &state, uint *nios) {
+    uint memBlocks = state.groupBlocks - 1;
+    block_t *slot = state.groupBuffer + memBlocks;
+    state.groupSize = 0;
+    state.groupPos = 0;
+    state.spillLoaded = -1;
+    for (uint i = 0; i < memBlocks; i++) {
+        emptyBlock(state.groupBuffer + i);
+    }
+    emptyBlock(slot);
+
+    const record_t *record;
+    while ((record = peekRecord(state.left, state.leftBlock, state.leftPos, nios))) {
+        if (state.groupSize != 0 && Key::compare(*record, state.groupBuffer[0].entries[0]) != 0) {
+            break;
+        }
+        uint block = state.groupSize / MAX_RECORDS_PER_BLOCK;
+        if (block < memBlocks) {
+            state.groupBuffer[block].entries[state.groupBuffer[block].nreserved++] = *record;
+        } else {
+            // the group does not fit on the buffer, so its full blocks are
+            // spilled. the spill file is overwritten by each group that spills
+            if (block == memBlocks && (*slot).nreserved == 0) {
+                if (state.spill < 0) {
+                    state.spill = open(state.spillFile, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU);
                 }
-                close(in1);
-                close(in2);
+                lseek(state.spill, 0, SEEK_SET);
+                countSyscall();
+            }
+            (*slot).entries[(*slot).nreserved++] = *record;
+            if ((*slot).nreserved == MAX_RECORDS_PER_BLOCK) {
+                (*nios) += writeBlocks(state.spill, slot, 1);
+                emptyBlock(slot);
             }
-            remove(tmpFile1);
-            remove(tmpFile2);
-            close(out);
         }
+        state.groupSize += 1;
+        state.leftPos += 1;
     }
-}
\ No newline at end of file
+    if ((*slot).nreserved != 0) {
+        (*nios) += writeBlocks(state.spill, slot, 1);
+    }
+}
+
+// returns the next block of pairs. the pairs of a record of right and a
+// group that do not fit on the output block are continued on the next call
+
+template <class Key>
+block_t *nextJoined(blockIterator *it, uint *nios) {
+    mergeJoinState &state = *(mergeJoinState*) (*it).state;
+    block_t *bufferOut = state.bufferOut;
+    emptyBlock(bufferOut);
+
+    while ((*bufferOut).nreserved < MAX_RECORDS_PER_BLOCK) {
+        const record_t *right = peekRecord(state.right, state.rightBlock, state.rightPos, nios);
+        if (!right) {
+            break;
+        }
+        // if the current record of right has the value of the group, it is
+        // joined with the next record of the group
+        if (state.groupSize != 0 && Key::compare(*right, state.groupBuffer[0].entries[0]) == 0) {
+            (*bufferOut).entries[(*bufferOut).nreserved++] = groupRecord(state, state.groupPos, nios);
+            (*bufferOut).entries[(*bufferOut).nreserved++] = *right;
+            (*state.nres) += 1;
+            state.groupPos += 1;
+            if (state.groupPos == state.groupSize) {
+                state.groupPos = 0;
+                state.rightPos += 1;
+            }
+            continue;
+        }
+        // otherwise the lower of the current records is skipped, until a new
+        // group of equal values is found
+        const record_t *left = peekRecord(state.left, state.leftBlock, state.leftPos, nios);
+        if (!left) {
+            break;
+        }
+        int cmp = Key::compare(*left, *right);
+        if (cmp < 0) {
+            state.leftPos += 1;
+        } else if (cmp > 0) {
+            state.rightPos += 1;
+        } else {
+            loadGroup<Key>(state, nios);
+        }
+    }
+    if ((*bufferOut).nreserved == 0) {
+        return NULL;
+    }
+    return bufferOut;
+}
+
+void closeMergeJoin(blockIterator *it) {
+    mergeJoinState *state = (mergeJoinState*) (*it).state;
+    closeIterator((*state).left);
+    closeIterator((*state).right);
+    if ((*state).spill >= 0) {
+        forgetFile((*state).spill);
+        close((*state).spill);
+        remove((*state).spillFile);
+    }
+    free((*state).spillFile);
+    closeSpace((*state).space);
+    free(state);
+}
+
+blockIterator *openMergeJoin(blockIterator *left, blockIterator *right, unsigned char field, block_t *groupBuffer, uint groupBlocks, block_t *bufferOut, uint *nres) {
+    // each merge join iterator has its own workspace, so that more than one can be open
+    mergeJoinState *state = (mergeJoinState*) malloc(sizeof (mergeJoinState));
+    if (!openSpace((*state).space)) {
+        free(state);
+        return NULL;
+    }
+    (*state).left = left;
+    (*state).right = right;
+    (*state).leftBlock = NULL;
+    (*state).leftPos = 0;
+    (*state).rightBlock = NULL;
+    (*state).rightPos = 0;
+    (*state).groupBuffer = groupBuffer;
+    (*state).groupBlocks = groupBlocks;
+    (*state).groupSize = 0;
+    (*state).groupPos = 0;
+    (*state).spillFile = tempPath((*state).space, "mjg");
+    (*state).spill = -1;
+    (*state).spillLoaded = -1;
+    (*state).bufferOut = bufferOut;
+    (*state).nres = nres;
+    (*bufferOut).valid = true;
+    switch (field) {
+        case 0:
+            return newIterator(nextJoined<RecidKey>, closeMergeJoin, state);
+        case 1:
+            return newIterator(nextJoined<NumKey>, closeMergeJoin, state);
+        case 2:
+            return newIterator(nextJoined<StrKey>, closeMergeJoin, state);
+        default:
+            return newIterator(nextJoined<NumStrKey>, closeMergeJoin, state);
+    }
+}
+
+void MergeJoin(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    MergeJoinSink(infile1, infile2, field, buffer, nmem_blocks, &sink, nres, nios);
+    closeFile(out);
+}
+
+void MergeJoinSink(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios) {
+
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    switch (field) {
+        case 0:
+            mergeJoin<RecidKey>(infile1, infile2, buffer, nmem_blocks, false, false, sink, nres, nios);
+            break;
+        case 1:
+            mergeJoin<NumKey>(infile1, infile2, buffer, nmem_blocks, false, false, sink, nres, nios);
+            break;
+        case 2:
+            mergeJoin<StrKey>(infile1, infile2, buffer, nmem_blocks, false, false, sink, nres, nios);
+            break;
+        default:
+            mergeJoin<NumStrKey>(infile1, infile2, buffer, nmem_blocks, false, false, sink, nres, nios);
+    }
+}
+
+void MergeOuterJoin(char *infile1, char *infile2, unsigned char field, unsigned char outer, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    MergeOuterJoinSink(infile1, infile2, field, outer, buffer, nmem_blocks, &sink, nres, nios);
+    closeFile(out);
+}
+
+void MergeOuterJoinSink(char *infile1, char *infile2, unsigned char field, unsigned char outer, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios) {
+
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    // the records of infile1 with no pair are kept for left and full outer
+    // joins, the ones of infile2 for right and full
+    bool keep1 = outer != 1;
+    bool keep2 = outer != 0;
+    switch (field) {
+        case 0:
+            mergeJoin<RecidKey>(infile1, infile2, buffer, nmem_blocks, keep1, keep2, sink, nres, nios);
+            break;
+        case 1:
+            mergeJoin<NumKey>(infile1, infile2, buffer, nmem_blocks, keep1, keep2, sink, nres, nios);
+            break;
+        case 2:
+            mergeJoin<StrKey>(infile1, infile2, buffer, nmem_blocks, keep1, keep2, sink, nres, nios);
+            break;
+        default:
+            mergeJoin<NumStrKey>(infile1, infile2, buffer, nmem_blocks, keep1, keep2, sink, nres, nios);
+    }
+}
+
+void MergeBandJoin(char *infile1, char *infile2, unsigned int delta, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    MergeBandJoinSink(infile1, infile2, delta, buffer, nmem_blocks, &sink, nres, nios);
+    closeFile(out);
+}
+
+void MergeBandJoinSink(char *infile1, char *infile2, unsigned int delta, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios) {
+
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    bandJoin(infile1, infile2, delta, buffer, nmem_blocks, sink, nres, nios);
+}
+
+void MultiMergeJoin(char **infiles, unsigned int ninputs, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    MultiMergeJoinSink(infiles, ninputs, field, buffer, nmem_blocks, &sink, nres, nios);
+    closeFile(out);
+}
+
+void MultiMergeJoinSink(char **infiles, unsigned int ninputs, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios) {
+
+    if (ninputs < 2 || ninputs > MAX_RECORDS_PER_BLOCK) {
+        printf("From 2 to %d inputs are required.", MAX_RECORDS_PER_BLOCK);
+        return;
+    }
+    // each input has a block pinned and there is one more for output
+    if (nmem_blocks < 3 || nmem_blocks < ninputs + 1) {
+        printf("At least 3 blocks and one more than the inputs are required.");
+        return;
+    }
+
+    switch (field) {
+        case 0:
+            multiMergeJoin<RecidKey>(infiles, ninputs, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        case 1:
+            multiMergeJoin<NumKey>(infiles, ninputs, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        case 2:
+            multiMergeJoin<StrKey>(infiles, ninputs, buffer, nmem_blocks, sink, nres, nios);
+            break;
+        default:
+            multiMergeJoin<NumStrKey>(infiles, ninputs, buffer, nmem_blocks, sink, nres, nios);
+    }
+}
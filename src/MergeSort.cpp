@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <fcntl.h> 
 #include <unistd.h>
 
@@ -29,45 +30,141 @@
 #include "bufferOps.h"
 #include "fileOps.h"
 #include "sortBuffer.h"
+#include "blockBatch.h"
+#include "pipeline.h"
+#include "blockSink.h"
+#include "directIO.h"
+#include "blockScan.h"
+#include "opStats.h"
+#include "tempSpace.h"
+
+// state of a merge of sorted segments. the merge is done in steps, each of
+// which fills one output block, so that the output can either be written to a
+// file or be passed to the next operator of a pipeline
+
+typedef struct {
+    int input;
+    // the first segsToMerge blocks hold the current block of each segment
+    block_t *buffer;
+    uint segsToMerge;
+    // number of blocks not yet loaded on buffer for each segment
+    uint *blocksLeft;
+    uint segmentSize;
+    uint firstSegOffset;
+    bool lastMergeOfPass;
+    uint sizeOfLastSeg;
+    // recordPtrs, one for each segment, that show the next record of the segment that is to be merged
+    recordPtr *nextRecord;
+    // number of segments that still have records to merge
+    uint segsLeft;
+    // a block of buffer that holds no segment, or NULL. the next block of the
+    // segment forecast to be over first is read on it ahead of time, while
+    // the merge goes on
+    block_t *spare;
+    // the segment whose next block is read on spare, or -1
+    int ahead;
+    // records still wanted from the merge. no block is read ahead that
+    // could only be needed after them
+    uint wanted;
+} mergeState;
 
 /*
  * input: file descriptor to the input file with the segments for merging
- * output: file descriptor to the output file where the one sorted segment to be produced will be written
  * buffer: the buffer used. the first blocks of each segment are already loaded
- * memSize: number of blocks in buffer to be used for merging. eg if memSize = 2, 2-way merge is used
- * segsToMerge: number of segments to merge. most times it will be equal to memSize.
+ * segsToMerge: number of segments to merge
  * blocksLeft: array that stores the number of blocks not yet loaded on buffer for each segment
  * segmentSize: the size of each segment in blocks. if that is the last merge of the pass, last segment may have fewer blocks
  * firstSegOffset: the offset of the first segment in the input file
- * field: which field will be used for sorting
- * lastPass: true if this is the last pass, meaning that after this merge the output file will be fully sorted
  * lastMergeOfPass: true if this is the last merge of the current pass
- 
- * returns the number of ios done during merge
+ * memSize: number of blocks of buffer the merge may use. if there are more than segsToMerge
+ * and the reads go through io_uring, one of them is used to read ahead
  */
-uint merge(int &input, int &output, block_t *buffer, uint memSize, uint segsToMerge, uint *blocksLeft, uint segmentSize, uint firstSegOffset, unsigned char field, bool lastPass, bool lastMergeOfPass) {
-
-    uint ios = 0;
-    // pointer to the last block of buffer, for convenience
-    block_t *bufferOut = buffer + memSize;
-    // number of blocks written to the output file during this merge
-    uint blocksWritten = 0;
+void startMerge(mergeState &state, int input, block_t *buffer, uint segsToMerge, uint *blocksLeft, uint segmentSize, uint firstSegOffset, bool lastMergeOfPass, uint memSize) {
+    state.input = input;
+    state.buffer = buffer;
+    state.segsToMerge = segsToMerge;
+    state.blocksLeft = blocksLeft;
+    state.segmentSize = segmentSize;
+    state.firstSegOffset = firstSegOffset;
+    state.lastMergeOfPass = lastMergeOfPass;
     // if that's the last merge of the current pass, last segment may have less than segmentSize blocks
-    uint sizeOfLastSeg;
-    if (lastMergeOfPass) {
-        sizeOfLastSeg = blocksLeft[segsToMerge - 1] + 1;
+    if (lastMergeOfPass && segsToMerge != 0) {
+        state.sizeOfLastSeg = blocksLeft[segsToMerge - 1] + 1;
     }
-
-    // array of recordPtrs, one for each segment, that shows to the next record of the segment that is to be merged
-    recordPtr *nextRecord = (recordPtr*) malloc(segsToMerge * sizeof (recordPtr));
+    state.nextRecord = (recordPtr*) malloc(segsToMerge * sizeof (recordPtr));
     for (uint i = 0; i < segsToMerge; i++) {
-        nextRecord[i] = newPtr(i * MAX_RECORDS_PER_BLOCK);
+        state.nextRecord[i] = newPtr(i * MAX_RECORDS_PER_BLOCK);
     }
-    emptyBlock(bufferOut);
-    (*bufferOut).blockid = 0;
+    state.segsLeft = segsToMerge;
+    state.spare = batchAsync() && segsToMerge < memSize ? buffer + segsToMerge : NULL;
+    state.ahead = -1;
+    state.wanted = UINT_MAX;
+}
+
+// returns the number of segments merged at once on memSize blocks. when the
+// reads go through io_uring, one of the blocks is kept to read ahead on
+
+inline uint mergeFanIn(uint memSize) {
+    if (memSize > 2 && batchAsync()) {
+        return memSize - 1;
+    }
+    return memSize;
+}
+
+// returns the offset in the input file of the next block of segment i
+
+inline uint nextBlockOffset(mergeState &state, uint i) {
+    if (state.lastMergeOfPass && i == state.segsToMerge - 1) {
+        return state.firstSegOffset + state.segmentSize * i + state.sizeOfLastSeg - state.blocksLeft[i];
+    }
+    return state.firstSegOffset + state.segmentSize * i + state.segmentSize - state.blocksLeft[i];
+}
+
+// reads ahead on spare the next block of the segment whose current block is
+// over first, which is the one whose last record is the lowest. a block that
+// is not full is the last one of its segment, so it is not considered, and
+// neither is the block if fewer records are wanted than its current one has
+// left. the read is submitted without waiting. returns the number of ios
+
+template <class Key>
+uint readAhead(mergeState &state) {
+    block_t *buffer = state.buffer;
+    const record_t *lowest = NULL;
+    int forecast = -1;
+    for (uint i = 0; i < state.segsToMerge; i++) {
+        const record_t &last = buffer[i].entries[MAX_RECORDS_PER_BLOCK - 1];
+        if (!buffer[i].valid || state.blocksLeft[i] == 0 || !last.valid) {
+            continue;
+        }
+        if (!lowest || Key::compare(last, *lowest) < 0) {
+            lowest = &last;
+            forecast = i;
+        }
+    }
+    if (forecast < 0 || state.wanted <= (uint) (MAX_RECORDS_PER_BLOCK - state.nextRecord[forecast].record)) {
+        return 0;
+    }
+    state.ahead = forecast;
+    uint ios = queueRead(state.input, state.spare, nextBlockOffset(state, forecast), 1);
+    submitBlocks();
+    return ios;
+}
 
-    uint segsToMergeCopy = segsToMerge;
-    while (segsToMergeCopy != 0) {
+// merges records to bufferOut, until either it is full or all the segments are over.
+// returns the number of ios done
+
+template <class Key>
+uint mergeRecords(mergeState &state, block_t *bufferOut) {
+    uint ios = 0;
+    block_t *buffer = state.buffer;
+    recordPtr *nextRecord = state.nextRecord;
+    uint *blocksLeft = state.blocksLeft;
+    uint segsToMerge = state.segsToMerge;
+    if (state.spare && state.ahead < 0) {
+        ios += readAhead<Key>(state);
+    }
+
+    while (state.segsLeft != 0 && (*bufferOut).nreserved < MAX_RECORDS_PER_BLOCK) {
         uint i;
         // finds the first valid block and setting its record as min, so that there is a value to compare to later
         for (i = 0; i < segsToMerge; i++) {
@@ -75,61 +172,137 @@ uint merge(int &input, int &output, block_t *buffer, uint memSize, uint segsToMe
                 break;
             }
         }
-        record_t minRec = getRecord(buffer, nextRecord[i]);
+        // the candidates are compared in place, only the min record is
+        // copied, to the output block
+        const record_t *minRec = &getRecord(buffer, nextRecord[i]);
         uint minBuffIndex = i;
 
         // compares the previously found min with the next records of each segment and
         // finds the record with minimum value
         for (uint j = i + 1; j < segsToMerge; j++) {
-            if (buffer[j].valid && compareRecords(getRecord(buffer, nextRecord[j]), minRec, field) < 0) {
-                minRec = getRecord(buffer, nextRecord[j]);
+            if (buffer[j].valid && Key::compare(getRecord(buffer, nextRecord[j]), *minRec) < 0) {
+                minRec = &getRecord(buffer, nextRecord[j]);
                 minBuffIndex = j;
             }
         }
 
-        // min record is written to the last block, which is used as output
-        (*bufferOut).entries[(*bufferOut).nreserved++] = minRec;
-
-        // if the last block is full, write it to the outfile and empty it
-        if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
-            ios += writeBlocks(output, bufferOut, 1);
-            (*bufferOut).blockid += 1;
-            blocksWritten += 1;
-            emptyBlock(bufferOut);
+        // min record is written to the output block
+        (*bufferOut).entries[(*bufferOut).nreserved++] = *minRec;
+        if (state.wanted != UINT_MAX) {
+            state.wanted -= 1;
         }
 
         // increases the recordPtr of the segment whose record was written
-        // to the last block
+        // to the output block
         incr(nextRecord[minBuffIndex]);
 
         // if the current block of that segment is over, loads the next one
-        // if there is one left or set it as invalid
+        // if there is one left or set it as invalid. if the block was read
+        // ahead, it is taken from spare, once its read is done, and the next
+        // block to be over is read ahead
         if (nextRecord[minBuffIndex].record == 0) {
             nextRecord[minBuffIndex].block -= 1;
             if (blocksLeft[minBuffIndex] > 0) {
-                uint blockOffset;
-                if (lastMergeOfPass && minBuffIndex == segsToMerge - 1) {
-                    blockOffset = firstSegOffset + segmentSize * minBuffIndex + sizeOfLastSeg - blocksLeft[minBuffIndex];
+                if (state.ahead == (int) minBuffIndex) {
+                    waitBlocks();
+                    buffer[minBuffIndex] = *state.spare;
+                    state.ahead = -1;
                 } else {
-                    blockOffset = firstSegOffset + segmentSize * minBuffIndex + segmentSize - blocksLeft[minBuffIndex];
+                    ios += preadBlocks(state.input, buffer + minBuffIndex, nextBlockOffset(state, minBuffIndex), 1);
                 }
-                ios += preadBlocks(input, buffer + minBuffIndex, blockOffset, 1);
                 blocksLeft[minBuffIndex] -= 1;
                 if (!buffer[minBuffIndex].valid) {
-                    segsToMergeCopy -= 1;
+                    state.segsLeft -= 1;
+                }
+                if (state.spare && state.ahead < 0) {
+                    ios += readAhead<Key>(state);
                 }
             } else {
                 buffer[minBuffIndex].valid = false;
-                segsToMergeCopy -= 1;
+                state.segsLeft -= 1;
             }
         } else {
             if (!getRecord(buffer, nextRecord[minBuffIndex]).valid) {
                 buffer[minBuffIndex].valid = false;
-                segsToMergeCopy -= 1;
+                state.segsLeft -= 1;
             }
         }
+        // if the segment read ahead is over, its block on spare is not needed
+        if (state.ahead == (int) minBuffIndex && !buffer[minBuffIndex].valid) {
+            waitBlocks();
+            state.ahead = -1;
+        }
     }
-    free(nextRecord);
+    return ios;
+}
+
+// frees the memory allocated for a merge. a read ahead still in flight is
+// waited for, as it is done on the buffer
+
+void endMerge(mergeState &state) {
+    if (state.ahead >= 0) {
+        waitBlocks();
+    }
+    free(state.nextRecord);
+}
+
+// loads the first block of each of the nSortedSegs segments of input on buffer
+// and starts their merge, which is the last one. the merge may use memSize
+// blocks of buffer. returns the number of ios
+
+uint startLastMerge(mergeState &state, int input, block_t *buffer, uint nSortedSegs, uint *blocksLeft, uint segmentSize, uint lastSegmentSize, uint memSize) {
+    uint ios = 0;
+    for (uint i = 0; i < nSortedSegs; i++) {
+        ios += queueRead(input, buffer + i, i * segmentSize, 1);
+        blocksLeft[i] = segmentSize - 1;
+    }
+    waitBlocks();
+    if (nSortedSegs != 0) {
+        blocksLeft[nSortedSegs - 1] = lastSegmentSize - 1;
+    }
+    startMerge(state, input, buffer, nSortedSegs, blocksLeft, segmentSize, 0, true, memSize);
+    return ios;
+}
+
+/*
+ * input: file descriptor to the input file with the segments for merging
+ * output: file descriptor to the output file where the one sorted segment to be produced will be written
+ * buffer: the buffer used. the first blocks of each segment are already loaded
+ * memSize: number of blocks in buffer to be used for merging. eg if memSize = 2, 2-way merge is used
+ * segsToMerge: number of segments to merge. most times it will be equal to memSize.
+ * blocksLeft: array that stores the number of blocks not yet loaded on buffer for each segment
+ * segmentSize: the size of each segment in blocks. if that is the last merge of the pass, last segment may have fewer blocks
+ * firstSegOffset: the offset of the first segment in the input file
+ * lastPass: true if this is the last pass, meaning that after this merge the output file will be fully sorted
+ * lastMergeOfPass: true if this is the last merge of the current pass
+ 
+ * returns the number of ios done during merge
+ */
+template <class Key>
+uint merge(int &input, int &output, block_t *buffer, uint memSize, uint segsToMerge, uint *blocksLeft, uint segmentSize, uint firstSegOffset, bool lastPass, bool lastMergeOfPass) {
+
+    uint ios = 0;
+    // pointer to the last block of buffer, for convenience
+    block_t *bufferOut = buffer + memSize;
+    // number of blocks written to the output file during this merge
+    uint blocksWritten = 0;
+
+    mergeState state;
+    startMerge(state, input, buffer, segsToMerge, blocksLeft, segmentSize, firstSegOffset, lastMergeOfPass, memSize);
+    emptyBlock(bufferOut);
+    (*bufferOut).blockid = 0;
+
+    while (state.segsLeft != 0) {
+        ios += mergeRecords<Key>(state, bufferOut);
+        // if the last block is full, write it to the outfile and empty it
+        if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
+            ios += writeBlocks(output, bufferOut, 1);
+            (*bufferOut).blockid += 1;
+            blocksWritten += 1;
+            emptyBlock(bufferOut);
+        }
+    }
+    endMerge(state);
 
     // after all segments are done, if there are records on the last block,
     // writes them on the output
@@ -139,12 +312,17 @@ uint merge(int &input, int &output, block_t *buffer, uint memSize, uint segsToMe
         blocksWritten += 1;
     }
 
-    // if that was not the last pass or the last merge of the current pass,
-    // adds to the output file dummy blocks, so that the offset of the sorted
-    // segments can be calculated on the next passes
-    // that is needed in case the blocks are not 100% utilised
-    if (!lastPass && !lastMergeOfPass) {
-        for (uint i = 0; i < (segmentSize * segsToMerge - blocksWritten); i++) {
+    // if that was not the last pass, adds to the output file dummy blocks, so
+    // that the offset and size of the sorted segments can be calculated on the
+    // next passes. that is needed in case the blocks are not 100% utilised.
+    // the segment of the last merge of the pass is padded to the size the next
+    // pass expects as well, otherwise blocks past the end of the file would be read
+    if (!lastPass) {
+        uint mergedSize = segmentSize * segsToMerge;
+        if (lastMergeOfPass) {
+            mergedSize = segmentSize * (segsToMerge - 1) + state.sizeOfLastSeg;
+        }
+        for (uint i = blocksWritten; i < mergedSize; i++) {
             ios += writeBlocks(output, buffer, 1);
         }
     }
@@ -152,26 +330,38 @@ uint merge(int &input, int &output, block_t *buffer, uint memSize, uint segsToMe
     return ios;
 }
 
-void MergeSort(char* infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char* outfile, unsigned int* nsorted_segs, unsigned int* npasses, unsigned int* nios) {
-
-    if (nmem_blocks < 3) {
-        printf("At least 3 blocks are required.");
-        return;
-    }
+/*
+ * infile: the file to be sorted
+ * buffer: the buffer used
+ * nmem_blocks: size of buffer
+ * maxSegs: the passes stop when there are at most maxSegs sorted segments left
+ * runBlocks: only the first runBlocks blocks of each segment sorted on the first pass are
+ * kept, when only the first records of the output are needed
+ * tmpFile1, tmpFile2: the two intermediate files. at the end tmpFile1 is the one with the sorted segments
+ * segmentSize: set to the size of each sorted segment left (with the exception of the last segment)
+ * lastSegmentSize: set to the size of the last sorted segment left
+ * nsorted_segs: number of sorted segments produced by the first pass
+ * npasses: number of passes
+ * nios: number of ios
+ *
+ * sorts the segments of infile that fit on buffer and then merges them, until
+ * at most maxSegs sorted segments are left. returns the number of segments left
+ */
+template <class Key>
+uint sortSegments(char* infile, block_t *buffer, uint nmem_blocks, uint maxSegs, uint runBlocks, char *&tmpFile1, char *&tmpFile2, uint &segmentSize, uint &lastSegmentSize, uint* nsorted_segs, uint* npasses, uint* nios) {
 
     // empties the buffer
     emptyBuffer(buffer, nmem_blocks);
 
     uint memSize = nmem_blocks - 1;
     int input, output;
-    char tmpFile1[] = ".ms1";
-    char tmpFile2[] = ".ms2";
 
     (*nsorted_segs) = 0;
     (*npasses) = 0;
     (*nios) = 0;
 
     uint infileBlocks = getSize(infile);
+    beginPhase("run generation", 1);
 
     // # of segments that completely fill the buffer
     uint fullSegments = infileBlocks / nmem_blocks;
@@ -180,10 +370,12 @@ void MergeSort(char* infile, unsigned char field, block_t *buffer, unsigned int
     uint remainingSegment = infileBlocks % nmem_blocks;
 
     input = open(infile, O_RDONLY, S_IRWXU);
-    output = open(tmpFile1, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+    // the sorted segments are compressed, unless there is only one, which
+    // becomes the outfile
+    output = openTemp(tmpFile1, O_WRONLY | O_CREAT | O_TRUNC, fullSegments + (remainingSegment != 0) > 1 || maxSegs > 1);
 
-    // sorts each segment in memory, then writes it to ".ms1"
-    uint segmentSize = nmem_blocks;
+    // sorts each segment in memory, then writes it to "ms1"
+    segmentSize = nmem_blocks;
     for (uint i = 0; i <= fullSegments; i++) {
         if (fullSegments == i) {
             if (remainingSegment != 0) {
@@ -193,52 +385,60 @@ void MergeSort(char* infile, unsigned char field, block_t *buffer, unsigned int
             }
         }
         (*nios) += readBlocks(input, buffer, segmentSize);
-        if (sortBuffer(buffer, segmentSize, field)) {
-            (*nios) += writeBlocks(output, buffer, segmentSize);
+        if (sortBuffer<Key>(buffer, segmentSize)) {
+            (*nios) += writeBlocks(output, buffer, segmentSize < runBlocks ? segmentSize : runBlocks);
             (*nsorted_segs) += 1;
         }
     }
     (*npasses) += 1;
     close(input);
-    close(output);
+    closeTemp(output);
 
 
     // # of blocks each sorted segment has (with the exception of the last segment)
     segmentSize = nmem_blocks;
     // # of blocks the last sorted segment will have in case it didn't fill the buffer completely
-    uint lastSegmentSize;
     if (remainingSegment == 0) {
         lastSegmentSize = nmem_blocks;
     } else {
         lastSegmentSize = remainingSegment;
     }
+    if (segmentSize > runBlocks) {
+        segmentSize = runBlocks;
+    }
+    if (lastSegmentSize > runBlocks) {
+        lastSegmentSize = runBlocks;
+    }
 
 
-    // two intermediate files, ".ms1" and ".ms2" are being used, the one as
+    // two intermediate files, "ms1" and "ms2" are being used, the one as
     // input and the other as output. after a pass is over, they switch roles.
-    // at the end, the sorted file, whether it is ".ms1" or ".ms2", is renamed
+    // at the end, the sorted file, whether it is "ms1" or "ms2", is renamed
     // to outfile while the other one is deleted
     // the outfile will always be 100% utilised (with the possible exception of
     // the last block), meaning that it may be smaller than the infile
     buffer[memSize].valid = true;
     uint nSortedSegs = (*nsorted_segs);
-    while (nSortedSegs > 1) {
-        input = open(tmpFile1, O_RDONLY, S_IRWXU);
-        output = open(tmpFile2, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+    uint fanIn = mergeFanIn(memSize);
+    while (nSortedSegs > maxSegs) {
+        beginPhase("merge", (*npasses) + 1);
+        // the output of the last pass is not compressed, if it becomes the outfile
+        input = openTemp(tmpFile1, O_RDONLY, false);
+        output = openTemp(tmpFile2, O_WRONLY | O_CREAT | O_TRUNC, nSortedSegs > fanIn || maxSegs > 1);
         uint newSortedSegs = 0;
-        // # of merges that utilise the buffer completely (memSize-way merge)
-        uint fullMerges = nSortedSegs / memSize;
+        // # of merges that utilise the buffer completely (fanIn-way merge)
+        uint fullMerges = nSortedSegs / fanIn;
         // # of sorted segments the last merge will merge in case it doesn't
         // utilise the buffer completely
-        uint lastMergeSegs = nSortedSegs % memSize;
+        uint lastMergeSegs = nSortedSegs % fanIn;
         // array that holds the number of blocks left to a sorted segment
         // during merging
         uint *blocksLeft = (uint*) malloc(memSize * sizeof (uint));
 
-        uint segsToMerge = memSize;
+        uint segsToMerge = fanIn;
         bool lastMerge = false;
         for (uint mergeCounter = 0; mergeCounter <= fullMerges; mergeCounter++) {
-            uint firstSegOffset = mergeCounter * memSize * segmentSize;
+            uint firstSegOffset = mergeCounter * fanIn * segmentSize;
 
             if (mergeCounter == fullMerges - 1 && lastMergeSegs == 0) {
                 lastMerge = true;
@@ -253,40 +453,635 @@ void MergeSort(char* infile, unsigned char field, block_t *buffer, unsigned int
                 }
             }
 
-            // loads the first block of each segment to merge on the buffer
+            // loads the first block of each segment to merge on the buffer.
+            // the reads are submitted together
             for (uint i = 0; i < segsToMerge; i++) {
-                (*nios) += preadBlocks(input, buffer + i, (firstSegOffset + i * segmentSize), 1);
+                (*nios) += queueRead(input, buffer + i, (firstSegOffset + i * segmentSize), 1);
                 blocksLeft[i] = segmentSize - 1;
             }
+            waitBlocks();
 
             // if that's the last merge of the current pass, the last segment may have less blocks
             if (lastMerge) {
                 blocksLeft[segsToMerge - 1] = lastSegmentSize - 1;
             }
 
-            (*nios) += merge(input, output, buffer, memSize, segsToMerge, blocksLeft, segmentSize, firstSegOffset, field, nSortedSegs <= memSize, lastMerge);
+            (*nios) += merge<Key>(input, output, buffer, memSize, segsToMerge, blocksLeft, segmentSize, firstSegOffset, nSortedSegs <= fanIn, lastMerge);
             newSortedSegs += 1;
         }
         free(blocksLeft);
 
         // updates variables for the next pass
         if (lastMergeSegs == 0) {
-            lastSegmentSize = (memSize - 1) * segmentSize + lastSegmentSize;
+            lastSegmentSize = (fanIn - 1) * segmentSize + lastSegmentSize;
         } else {
             lastSegmentSize = (lastMergeSegs - 1) * segmentSize + lastSegmentSize;
         }
-        segmentSize *= memSize;
+        segmentSize *= fanIn;
         nSortedSegs = newSortedSegs;
         (*npasses) += 1;
-        close(input);
-        close(output);
+        closeTemp(input);
+        closeTemp(output);
 
-        // swaps the files e.g if during this pass ".ms1" was used as input, next
+        // swaps the files e.g if during this pass "ms1" was used as input, next
         // pass it will be used as output
-        char tmp = tmpFile1[3];
-        tmpFile1[3] = tmpFile2[3];
-        tmpFile2[3] = tmp;
+        char *tmp = tmpFile1;
+        tmpFile1 = tmpFile2;
+        tmpFile2 = tmp;
+    }
+    endPhase();
+    return nSortedSegs;
+}
+
+// passes block to sink, if there are records left to limit. the records
+// after the first limit are dropped. returns the number of ios
+
+inline uint putLimited(blockSink *sink, block_t *block, uint &limit) {
+    if (limit == 0) {
+        return 0;
+    }
+    if ((*block).nreserved > limit) {
+        (*block).nreserved = limit;
+    }
+    limit -= (*block).nreserved;
+    return putBlock(sink, block);
+}
+
+// number of blocks that limit records fill
+
+inline uint limitBlocks(uint limit) {
+    return limit / MAX_RECORDS_PER_BLOCK + (limit % MAX_RECORDS_PER_BLOCK != 0);
+}
+
+/*
+ * infile: the file to be sorted
+ * limit: number of records wanted
+ * buffer: the buffer used
+ * nmem_blocks: size of buffer
+ * sink: receives the output blocks
+ * nsorted_segs: 1, if there are valid records
+ * npasses: 1
+ * nios: number of ios
+ *
+ * when the first limit records fill at most half the buffer, they are kept on
+ * the first blocks of buffer, while infile is read on the rest. each time
+ * the rest is loaded, its records that are not lower than the current limit-th
+ * one are dropped, and the ones left are sorted together with the current
+ * first ones. infile is read once and nothing is written but the output
+ */
+template <class Key>
+void topRecords(char* infile, uint limit, block_t *buffer, uint nmem_blocks, blockSink *sink, uint* nsorted_segs, uint* npasses, uint* nios) {
+    emptyBuffer(buffer, nmem_blocks);
+    (*nsorted_segs) = 0;
+    (*npasses) = 1;
+    (*nios) = 0;
+    beginPhase("top records", 1);
+
+    uint topBlocks = limitBlocks(limit);
+    block_t *chunk = buffer + topBlocks;
+    uint chunkSize = nmem_blocks - topBlocks;
+    // number of records on the first topBlocks blocks
+    uint topSize = 0;
+    for (uint i = 0; i < topBlocks; i++) {
+        buffer[i].valid = false;
+    }
+
+    uint infileBlocks = getSize(infile);
+    int input = open(infile, O_RDONLY, S_IRWXU);
+    for (uint read = 0; read < infileBlocks; read += chunkSize) {
+        uint size = infileBlocks - read < chunkSize ? infileBlocks - read : chunkSize;
+        (*nios) += readBlocks(input, chunk, size);
+
+        // once there are limit records, only the lower ones are candidates. the
+        // flags of the records dropped are cleared, so the blocks are left in
+        // flags form
+        if (topSize == limit) {
+            const record_t &last = getRecord(buffer, newPtr(limit - 1));
+            bool candidates = false;
+            for (uint b = 0; b < size; b++) {
+                if (!chunk[b].valid) {
+                    continue;
+                }
+                recordMask valid = validRecords(chunk + b);
+                for (int r = nextValid(valid); r >= 0; r = nextValid(valid)) {
+                    if (Key::compare(chunk[b].entries[r], last) >= 0) {
+                        chunk[b].entries[r].valid = false;
+                    } else {
+                        candidates = true;
+                    }
+                }
+                chunk[b].dummy = 0;
+            }
+            if (!candidates) {
+                continue;
+            }
+        }
+
+        if (sortBuffer<Key>(buffer, topBlocks + size)) {
+            // keeps the first limit records
+            topSize = 0;
+            for (uint b = 0; b < topBlocks && buffer[b].valid; b++) {
+                topSize += buffer[b].nreserved;
+            }
+            if (topSize > limit) {
+                buffer[topBlocks - 1].nreserved -= topSize - limit;
+                topSize = limit;
+            }
+        }
+    }
+    close(input);
+
+    if (topSize != 0) {
+        (*nsorted_segs) = 1;
     }
-    rename(tmpFile1, outfile);
+    for (uint b = 0; b < topBlocks && topSize != 0; b++) {
+        buffer[b].blockid = b;
+        (*nios) += putLimited(sink, buffer + b, topSize);
+    }
+    endPhase();
+}
+
+// external mergesort of infile on the field of the key policy. the output
+// of the last pass is passed to sink, which only receives the first limit
+// records. the segments sorted on the first pass are cut to their first limit
+// records, as the rest can not be in the output
+
+template <class Key>
+void mergeSort(char* infile, uint limit, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int* nsorted_segs, unsigned int* npasses, unsigned int* nios) {
+    if (limit == 0) {
+        (*nsorted_segs) = 0;
+        (*npasses) = 0;
+        (*nios) = 0;
+        return;
+    }
+
+    uint infileBlocks = getSize(infile);
+
+    // if infile fits on the buffer, it is sorted in memory and its blocks are
+    // passed to sink directly
+    if (infileBlocks <= nmem_blocks) {
+        beginPhase("run generation", 1);
+        emptyBuffer(buffer, nmem_blocks);
+        (*nsorted_segs) = 0;
+        (*npasses) = 1;
+        (*nios) = readBlocks(infile, buffer, infileBlocks);
+        if (infileBlocks != 0 && sortBuffer<Key>(buffer, infileBlocks)) {
+            (*nsorted_segs) = 1;
+            for (uint i = 0; i < infileBlocks && buffer[i].valid && limit != 0; i++) {
+                buffer[i].blockid = i;
+                (*nios) += putLimited(sink, buffer + i, limit);
+            }
+        }
+        endPhase();
+        return;
+    }
+
+    // if the output fills at most half the buffer, infile is scanned once
+    if (limitBlocks(limit) <= nmem_blocks / 2) {
+        topRecords<Key>(infile, limit, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+        return;
+    }
+
+    // the temp files are kept in a workspace of this sort
+    tempSpace space;
+    if (!openSpace(space)) {
+        (*nsorted_segs) = 0;
+        (*npasses) = 0;
+        (*nios) = 0;
+        return;
+    }
+    char *tmpName1 = tempPath(space, "ms1");
+    char *tmpName2 = tempPath(space, "ms2");
+    char *tmpFile1 = tmpName1;
+    char *tmpFile2 = tmpName2;
+    uint segmentSize, lastSegmentSize;
+
+    // the passes stop when the segments left can be merged at once
+    uint nSortedSegs = sortSegments<Key>(infile, buffer, nmem_blocks, mergeFanIn(nmem_blocks - 1), limitBlocks(limit), tmpFile1, tmpFile2, segmentSize, lastSegmentSize, nsorted_segs, npasses, nios);
+    remove(tmpFile2);
+
+    // the last pass merges them to sink
+    beginPhase("merge", (*npasses) + 1);
+    int input = openTemp(tmpFile1, O_RDONLY, false);
+    uint *blocksLeft = (uint*) malloc(nmem_blocks * sizeof (uint));
+    block_t *bufferOut = buffer + nmem_blocks - 1;
+    mergeState state;
+    (*nios) += startLastMerge(state, input, buffer, nSortedSegs, blocksLeft, segmentSize, lastSegmentSize, nmem_blocks - 1);
+    state.wanted = limit;
+    emptyBlock(bufferOut);
+    (*bufferOut).valid = true;
+    (*bufferOut).blockid = 0;
+    // the merge stops once limit records are passed to sink
+    while (state.segsLeft != 0 && limit != 0) {
+        (*nios) += mergeRecords<Key>(state, bufferOut);
+        if ((*bufferOut).nreserved == MAX_RECORDS_PER_BLOCK) {
+            (*nios) += putLimited(sink, bufferOut, limit);
+            (*bufferOut).blockid += 1;
+            emptyBlock(bufferOut);
+        }
+    }
+    if ((*bufferOut).nreserved != 0) {
+        (*nios) += putLimited(sink, bufferOut, limit);
+    }
+    endMerge(state);
+    free(blocksLeft);
+    closeTemp(input);
+    remove(tmpFile1);
+    free(tmpName1);
+    free(tmpName2);
+    closeSpace(space);
+    (*npasses) += 1;
+    endPhase();
+}
+
+/*
+ * infile: the file to be sorted
+ * infileBlocks: size of infile
+ * buffer: the buffer used
+ * nmem_blocks: size of buffer
+ * splitters: set to an array with the nparts - 1 records that split the values of
+ * infile in nparts ranges
+ * nios: number of ios
+ *
+ * loads a quarter of the buffer with blocks spread evenly over infile and sorts
+ * them. the number of ranges is chosen so that each one is expected to fit on the
+ * buffer, with some room for the error of the sample, and they are split by evenly
+ * spaced records of the sample. a splitter equal to the previous one or to the
+ * lowest value of the sample is dropped, so that no range is expected to be empty.
+ * if the values can not be split, 1 is returned.
+ *
+ * returns the number of ranges, nparts
+ */
+template <class Key>
+uint chooseSplitters(char *infile, uint infileBlocks, block_t *buffer, uint nmem_blocks, record_t *&splitters, uint *nios) {
+    uint sampleSize = (nmem_blocks + 3) / 4;
+    if (sampleSize > infileBlocks) {
+        sampleSize = infileBlocks;
+    }
+    int in = open(infile, O_RDONLY, S_IRWXU);
+    for (uint i = 0; i < sampleSize; i++) {
+        (*nios) += preadBlocks(in, buffer + i, i * (infileBlocks / sampleSize), 1);
+    }
+    close(in);
+    if (!sortBuffer<Key>(buffer, sampleSize)) {
+        return 1;
+    }
+    uint sampled = 0;
+    for (uint i = 0; i < sampleSize && buffer[i].valid; i++) {
+        sampled += buffer[i].nreserved;
+    }
+
+    // the blocks the output is expected to have, plus a quarter
+    double outBlocks = 1.25 * sampled * infileBlocks / sampleSize / MAX_RECORDS_PER_BLOCK;
+    uint nparts = (uint) (outBlocks / nmem_blocks) + 1;
+    // one block of the buffer is needed for each range and one for input
+    if (nparts > nmem_blocks - 1) {
+        nparts = nmem_blocks - 1;
+    }
+    if (nparts > sampled) {
+        nparts = sampled;
+    }
+
+    splitters = (record_t*) malloc(nparts * sizeof (record_t));
+    uint nsplitters = 0;
+    const record_t *previous = &getRecord(buffer, newPtr(0));
+    for (uint i = 1; i < nparts; i++) {
+        const record_t &splitter = getRecord(buffer, newPtr((uint) ((double) i * sampled / nparts)));
+        if (Key::compare(*previous, splitter) != 0) {
+            splitters[nsplitters++] = splitter;
+            previous = &splitter;
+        }
+    }
+    return nsplitters + 1;
+}
+
+// returns the range of record, which is the number of splitters not higher than it
+
+template <class Key>
+inline uint findRange(const record_t &record, record_t *splitters, uint nsplitters) {
+    uint low = 0, high = nsplitters;
+    while (low < high) {
+        uint mid = (low + high) / 2;
+        if (Key::compare(splitters[mid], record) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * infile: the file to be partitioned
+ * infileBlocks: size of infile
+ * buffer: the buffer used
+ * nparts: number of ranges
+ * splitters: the nparts - 1 records that split the ranges
+ * partFilenames: the files of the ranges, which are created
+ * nios: number of ios
+ *
+ * each block of infile is loaded on block nparts of buffer and each of its records
+ * is moved to the block of its range, one of the first nparts blocks. a full block
+ * is written to the file of its range. this is similar to createBucketFiles of
+ * HashJoin.cpp, but the partitions are ordered: all the values of a partition are
+ * lower than the ones of the next partition
+ */
+template <class Key>
+void scatterRanges(char *infile, uint infileBlocks, block_t *buffer, uint nparts, record_t *splitters, char **partFilenames, uint *nios) {
+    int *partFiles = (int*) malloc(nparts * sizeof (int));
+    for (uint i = 0; i < nparts; i++) {
+        partFiles[i] = openFile(partFilenames[i], O_WRONLY | O_CREAT | O_TRUNC | O_APPEND);
+        emptyBlock(buffer + i);
+        buffer[i].valid = true;
+    }
+
+    block_t *bufferSlot = buffer + nparts;
+    blockScan file;
+    openScan(file, infile);
+    for (uint i = 0; i < infileBlocks; i++) {
+        block_t *bufferIn = nextBlock(file, bufferSlot, nios);
+        if (!(*bufferIn).valid) {
+            continue;
+        }
+        recordMask valid = validRecords(bufferIn);
+        for (int j = nextValid(valid); j >= 0; j = nextValid(valid)) {
+            const record_t &record = (*bufferIn).entries[j];
+            uint index = findRange<Key>(record, splitters, nparts - 1);
+            buffer[index].entries[buffer[index].nreserved++] = record;
+            if (buffer[index].nreserved == MAX_RECORDS_PER_BLOCK) {
+                (*nios) += writeBlocks(partFiles[index], buffer + index, 1);
+                emptyBlock(buffer + index);
+            }
+        }
+    }
+    closeScan(file);
+
+    // the blocks with records left are written together
+    for (uint i = 0; i < nparts; i++) {
+        if (buffer[i].nreserved != 0) {
+            (*nios) += queueAppend(partFiles[i], buffer + i, 1);
+        }
+    }
+    waitBlocks();
+    for (uint i = 0; i < nparts; i++) {
+        closeFile(partFiles[i]);
+    }
+    free(partFiles);
+}
+
+// passes the blocks of the sorted partitions to the sink of the distribution
+// sort, numbering them across the partitions
+
+typedef struct {
+    blockSink *sink;
+    uint blockid;
+} partitionSink;
+
+uint putPartition(blockSink *sink, block_t *block) {
+    partitionSink *state = (partitionSink*) (*sink).state;
+    (*block).blockid = (*state).blockid++;
+    return putBlock((*state).sink, block);
+}
+
+// distribution sort of infile on the field of the key policy. infile is split
+// in ranges of values, which are sorted one after the other. a range that fits
+// on the buffer is sorted in memory, a larger one is split again
+
+template <class Key>
+void distributionSort(char *infile, block_t *buffer, uint nmem_blocks, blockSink *sink, uint *nsorted_segs, uint *npasses, uint *nios) {
+    uint infileBlocks = getSize(infile);
+    uint sampleIos = 0;
+    uint nparts = 1;
+    record_t *splitters = NULL;
+    if (infileBlocks > nmem_blocks) {
+        beginPhase("sampling", 0);
+        nparts = chooseSplitters<Key>(infile, infileBlocks, buffer, nmem_blocks, splitters, &sampleIos);
+    }
+
+    // if infile fits on the buffer, or its values can not be split, it is merge sorted
+    if (nparts == 1) {
+        mergeSort<Key>(infile, UINT_MAX, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+        (*nios) += sampleIos;
+        free(splitters);
+        return;
+    }
+
+    (*nsorted_segs) = 0;
+    (*npasses) = 1;
+    (*nios) = sampleIos;
+
+    // the ranges are kept in a workspace of this level
+    tempSpace space;
+    if (!openSpace(space)) {
+        free(splitters);
+        return;
+    }
+    char **partFilenames = (char**) malloc(nparts * sizeof (char*));
+    for (uint i = 0; i < nparts; i++) {
+        char name[16];
+        sprintf(name, "ds%u", i);
+        partFilenames[i] = tempPath(space, name);
+    }
+    beginPhase("distribution", 1);
+    emptyBuffer(buffer, nmem_blocks);
+    scatterRanges<Key>(infile, infileBlocks, buffer, nparts, splitters, partFilenames, nios);
+    free(splitters);
+
+    partitionSink numbering;
+    numbering.sink = sink;
+    numbering.blockid = 0;
+    blockSink partSink;
+    partSink.put = putPartition;
+    partSink.fd = -1;
+    partSink.state = &numbering;
+
+    // the partitions are sorted in order. npasses counts the passes of the
+    // partition that needed the most
+    uint maxPasses = 0;
+    for (uint i = 0; i < nparts; i++) {
+        uint segs, passes, ios;
+        // a range that does not fit on the buffer is distributed again, unless
+        // it is as large as infile, because then its values could not be split
+        uint partBlocks = getSize(partFilenames[i]);
+        if (partBlocks > nmem_blocks && partBlocks < infileBlocks) {
+            distributionSort<Key>(partFilenames[i], buffer, nmem_blocks, &partSink, &segs, &passes, &ios);
+        } else {
+            mergeSort<Key>(partFilenames[i], UINT_MAX, buffer, nmem_blocks, &partSink, &segs, &passes, &ios);
+        }
+        (*nios) += ios;
+        (*nsorted_segs) += segs;
+        if (passes > maxPasses) {
+            maxPasses = passes;
+        }
+        remove(partFilenames[i]);
+        free(partFilenames[i]);
+    }
+    free(partFilenames);
+    closeSpace(space);
+    (*npasses) += maxPasses;
+}
+
+// state of a sort iterator
+
+typedef struct {
+    tempSpace space;
+    char *tmpName1;
+    char *tmpName2;
+    // the file with the segments of the last merge
+    char *tmpFile;
+    int input;
+    uint nSortedSegs;
+    uint segmentSize;
+    uint lastSegmentSize;
+    block_t *mergeBuffer;
+    uint mergeBlocks;
+    uint *blocksLeft;
+    // true once the first blocks of the segments are loaded and the merge is started
+    bool started;
+    mergeState merge;
+} sortState;
+
+// returns the next block of the last merge. the merge is started on the first call
+
+template <class Key>
+block_t *nextSorted(blockIterator *it, uint *nios) {
+    sortState &state = *(sortState*) (*it).state;
+    block_t *bufferOut = state.mergeBuffer + state.mergeBlocks - 1;
+    if (!state.started) {
+        state.started = true;
+        state.input = openTemp(state.tmpFile, O_RDONLY, false);
+        state.blocksLeft = (uint*) malloc(state.mergeBlocks * sizeof (uint));
+        (*nios) += startLastMerge(state.merge, state.input, state.mergeBuffer, state.nSortedSegs, state.blocksLeft, state.segmentSize, state.lastSegmentSize, state.mergeBlocks - 1);
+        (*bufferOut).valid = true;
+    }
+    emptyBlock(bufferOut);
+    (*nios) += mergeRecords<Key>(state.merge, bufferOut);
+    if ((*bufferOut).nreserved == 0) {
+        return NULL;
+    }
+    return bufferOut;
+}
+
+void closeSort(blockIterator *it) {
+    sortState *state = (sortState*) (*it).state;
+    if ((*state).started) {
+        endMerge((*state).merge);
+        free((*state).blocksLeft);
+        closeTemp((*state).input);
+    }
+    remove((*state).tmpFile);
+    free((*state).tmpName1);
+    free((*state).tmpName2);
+    closeSpace((*state).space);
+    free(state);
+}
+
+// sorts infile until there are as many segments left as the blocks of the
+// last merge can hold
+
+template <class Key>
+blockIterator *openSort(char *infile, block_t *buffer, uint nmem_blocks, block_t *mergeBuffer, uint mergeBlocks, uint *nios) {
+    // each sort iterator has its own workspace, so that more than one can be open
+    sortState *state = (sortState*) malloc(sizeof (sortState));
+    if (!openSpace((*state).space)) {
+        free(state);
+        return NULL;
+    }
+    (*state).tmpName1 = tempPath((*state).space, "ms1");
+    (*state).tmpName2 = tempPath((*state).space, "ms2");
+    char *tmpFile1 = (*state).tmpName1;
+    char *tmpFile2 = (*state).tmpName2;
+
+    uint nsorted_segs, npasses, ios;
+    (*state).nSortedSegs = sortSegments<Key>(infile, buffer, nmem_blocks, mergeFanIn(mergeBlocks - 1), nmem_blocks, tmpFile1, tmpFile2, (*state).segmentSize, (*state).lastSegmentSize, &nsorted_segs, &npasses, &ios);
+    (*nios) += ios;
     remove(tmpFile2);
-}
\ No newline at end of file
+
+    (*state).tmpFile = tmpFile1;
+    (*state).mergeBuffer = mergeBuffer;
+    (*state).mergeBlocks = mergeBlocks;
+    (*state).started = false;
+    return newIterator(nextSorted<Key>, closeSort, state);
+}
+
+blockIterator *openSort(char *infile, unsigned char field, block_t *buffer, uint nmem_blocks, block_t *mergeBuffer, uint mergeBlocks, uint *nios) {
+    switch (field) {
+        case 0:
+            return openSort<RecidKey>(infile, buffer, nmem_blocks, mergeBuffer, mergeBlocks, nios);
+        case 1:
+            return openSort<NumKey>(infile, buffer, nmem_blocks, mergeBuffer, mergeBlocks, nios);
+        case 2:
+            return openSort<StrKey>(infile, buffer, nmem_blocks, mergeBuffer, mergeBlocks, nios);
+        default:
+            return openSort<NumStrKey>(infile, buffer, nmem_blocks, mergeBuffer, mergeBlocks, nios);
+    }
+}
+
+void MergeSort(char* infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char* outfile, unsigned int* nsorted_segs, unsigned int* npasses, unsigned int* nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    MergeSortSink(infile, field, buffer, nmem_blocks, &sink, nsorted_segs, npasses, nios);
+    closeFile(out);
+}
+
+void MergeSortSink(char* infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int* nsorted_segs, unsigned int* npasses, unsigned int* nios) {
+    MergeSortLimitSink(infile, field, UINT_MAX, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+}
+
+void MergeSortLimit(char* infile, unsigned char field, unsigned int limit, block_t *buffer, unsigned int nmem_blocks, char* outfile, unsigned int* nsorted_segs, unsigned int* npasses, unsigned int* nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    MergeSortLimitSink(infile, field, limit, buffer, nmem_blocks, &sink, nsorted_segs, npasses, nios);
+    closeFile(out);
+}
+
+void MergeSortLimitSink(char* infile, unsigned char field, unsigned int limit, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int* nsorted_segs, unsigned int* npasses, unsigned int* nios) {
+
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    switch (field) {
+        case 0:
+            mergeSort<RecidKey>(infile, limit, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+            break;
+        case 1:
+            mergeSort<NumKey>(infile, limit, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+            break;
+        case 2:
+            mergeSort<StrKey>(infile, limit, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+            break;
+        default:
+            mergeSort<NumStrKey>(infile, limit, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+    }
+}
+
+void DistributionSort(char* infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char* outfile, unsigned int* nsorted_segs, unsigned int* npasses, unsigned int* nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    DistributionSortSink(infile, field, buffer, nmem_blocks, &sink, nsorted_segs, npasses, nios);
+    closeFile(out);
+}
+
+void DistributionSortSink(char* infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int* nsorted_segs, unsigned int* npasses, unsigned int* nios) {
+
+    if (nmem_blocks < 3) {
+        printf("At least 3 blocks are required.");
+        return;
+    }
+
+    switch (field) {
+        case 0:
+            distributionSort<RecidKey>(infile, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+            break;
+        case 1:
+            distributionSort<NumKey>(infile, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+            break;
+        case 2:
+            distributionSort<StrKey>(infile, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+            break;
+        default:
+            distributionSort<NumStrKey>(infile, buffer, nmem_blocks, sink, nsorted_segs, npasses, nios);
+    }
+}
@@ -0,0 +1,229 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include "blockBatch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "bufferOps.h"
+
+// number of ios that can be queued before the ring has to be submitted
+#define RING_ENTRIES 64
+
+// an io_uring, with pointers to the shared submission and completion rings
+
+struct ioRing {
+    int fd;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_sqe *sqes;
+    io_uring_cqe *cqes;
+    void *sqRing, *cqRing;
+    size_t sqRingSize, cqRingSize;
+    // ios queued but not yet submitted
+    unsigned queued;
+    // ios submitted but not yet completed
+    unsigned inFlight;
+    // requests of the ios in flight, indexed by user_data, so that short
+    // transfers can be completed
+    io_uring_sqe requests[RING_ENTRIES];
+};
+
+static thread_local batchBackend backendUsed = BATCH_SYNC;
+static thread_local ioRing *ring = NULL;
+
+// sets up an io_uring and maps its rings. returns NULL if that fails
+
+ioRing *createRing() {
+    io_uring_params params;
+    memset(&params, 0, sizeof (params));
+    int fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (fd < 0) {
+        return NULL;
+    }
+    ioRing *r = (ioRing*) malloc(sizeof (ioRing));
+    r->fd = fd;
+    r->queued = 0;
+    r->inFlight = 0;
+    r->sqRingSize = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+    r->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof (io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cqRingSize > r->sqRingSize) {
+            r->sqRingSize = r->cqRingSize;
+        }
+        r->cqRingSize = r->sqRingSize;
+    }
+    r->sqRing = mmap(NULL, r->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cqRing = r->sqRing;
+    } else {
+        r->cqRing = mmap(NULL, r->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    r->sqes = (io_uring_sqe*) mmap(NULL, params.sq_entries * sizeof (io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqRing == MAP_FAILED || r->cqRing == MAP_FAILED || r->sqes == MAP_FAILED) {
+        close(fd);
+        free(r);
+        return NULL;
+    }
+    char *sq = (char*) r->sqRing;
+    r->sqHead = (unsigned*) (sq + params.sq_off.head);
+    r->sqTail = (unsigned*) (sq + params.sq_off.tail);
+    r->sqMask = (unsigned*) (sq + params.sq_off.ring_mask);
+    r->sqArray = (unsigned*) (sq + params.sq_off.array);
+    char *cq = (char*) r->cqRing;
+    r->cqHead = (unsigned*) (cq + params.cq_off.head);
+    r->cqTail = (unsigned*) (cq + params.cq_off.tail);
+    r->cqMask = (unsigned*) (cq + params.cq_off.ring_mask);
+    r->cqes = (io_uring_cqe*) (cq + params.cq_off.cqes);
+    return r;
+}
+
+void setBatchBackend(batchBackend backend) {
+    backendUsed = backend;
+    if (backend == BATCH_URING && !ring) {
+        ring = createRing();
+    }
+}
+
+bool batchAsync() {
+    return backendUsed == BATCH_URING && ring;
+}
+
+// true if ios of fd are queued in the ring. files opened with O_DIRECT go
+// through their bounce buffer, and compressed temp files through the codec,
+// so they are always read and written directly
+
+inline bool useRing(int fd) {
+    return backendUsed == BATCH_URING && ring && !isDirect(fd) && !isCompressed(fd);
+}
+
+// submits the queued ios, waiting for at least minComplete of them
+
+void enterRing(uint minComplete) {
+    uint flags = 0;
+    if (minComplete != 0) {
+        flags = IORING_ENTER_GETEVENTS;
+    }
+    syscall(__NR_io_uring_enter, ring->fd, ring->queued, minComplete, flags, NULL, 0);
+    countSyscall();
+    ring->inFlight += ring->queued;
+    ring->queued = 0;
+}
+
+// completes a transfer the ring did only partly, or not at all
+
+void completeRequest(io_uring_sqe &request, int done) {
+    if (done < 0) {
+        done = 0;
+    }
+    if ((uint) done == request.len) {
+        return;
+    }
+    char *data = (char*) request.addr + done;
+    // the bytes were counted when the request was queued
+    if (request.opcode == IORING_OP_READ) {
+        pread(request.fd, data, request.len - done, request.off + done);
+    } else {
+        write(request.fd, data, request.len - done);
+    }
+    countSyscall();
+}
+
+// reaps the completions available
+
+void reapRing() {
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+        completeRequest(ring->requests[cqe->user_data], cqe->res);
+        ring->inFlight -= 1;
+        head += 1;
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+}
+
+void waitBlocks() {
+    if (!ring) {
+        return;
+    }
+    enterRing(0);
+    while (ring->inFlight != 0) {
+        syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        countSyscall();
+        reapRing();
+    }
+}
+
+void submitBlocks() {
+    if (ring && ring->queued != 0) {
+        enterRing(0);
+    }
+}
+
+// adds a request to the submission ring. if the ring is full, waits for the
+// ios already queued first
+
+void queueRequest(__u8 opcode, int fd, block_t *buffer, uint bytes, __u64 offset) {
+    if (ring->queued + ring->inFlight == RING_ENTRIES) {
+        waitBlocks();
+    }
+    // a free slot of requests is found. user_data is its index
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & *ring->sqMask;
+    io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof (io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long) buffer;
+    sqe->len = bytes;
+    sqe->off = offset;
+    sqe->user_data = (tail % RING_ENTRIES);
+    ring->requests[sqe->user_data] = *sqe;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued += 1;
+    countIo(fd, offset == (__u64) -1 ? -1 : (off_t) offset, bytes, opcode == IORING_OP_WRITE);
+}
+
+uint queueRead(int fd, block_t *buffer, uint offset, uint size) {
+    if (!useRing(fd)) {
+        return preadBlocks(fd, buffer, offset, size);
+    }
+    queueRequest(IORING_OP_READ, fd, buffer, size * sizeof (block_t), (__u64) offset * sizeof (block_t));
+    return size;
+}
+
+uint queueAppend(int fd, block_t *buffer, uint size) {
+    if (!useRing(fd)) {
+        return writeBlocks(fd, buffer, size);
+    }
+    syncFlags(buffer, size);
+    // offset -1 writes at the current position, which is the end of an
+    // O_APPEND file
+    queueRequest(IORING_OP_WRITE, fd, buffer, size * sizeof (block_t), (__u64) -1);
+    return size;
+}
@@ -0,0 +1,63 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef BLOCKBATCH_H
+#define	BLOCKBATCH_H
+
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// backends that can be used for batches of block ios
+// BATCH_SYNC: each io is performed when queued, with pread or write
+// BATCH_URING: the ios are queued in an io_uring and submitted together
+
+enum batchBackend {
+    BATCH_SYNC,
+    BATCH_URING
+};
+
+// sets the backend used for batches of the calling thread. if io_uring is not
+// available, BATCH_SYNC is used. the default is BATCH_SYNC
+void setBatchBackend(batchBackend backend);
+
+// true if the batches of the calling thread go through io_uring, so that
+// submitted ios are done while the caller goes on. operators then keep blocks
+// aside for ios in flight
+bool batchAsync();
+
+// queues the read of size blocks, starting from block offset of the file
+// described by fd, to buffer. returns the number of ios (size)
+uint queueRead(int fd, block_t *buffer, uint offset, uint size);
+
+// queues the write of size blocks from buffer to the end of the file described
+// by fd, which must be opened with O_APPEND. only one append to each file
+// may be queued until waitBlocks is called. returns the number of ios (size)
+uint queueAppend(int fd, block_t *buffer, uint size);
+
+// submits the queued ios without waiting for them to complete, so that the
+// caller can do other work. the buffers must not be touched until waitBlocks
+void submitBlocks();
+
+// submits the queued ios and waits for all submitted ios to complete
+void waitBlocks();
+
+#endif
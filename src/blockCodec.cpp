@@ -0,0 +1,344 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include "blockCodec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "bufferOps.h"
+
+// files with a descriptor higher than this are not compressed
+#define MAX_CODEC_FILES 1024
+
+// bytes of the block fields that are stored as they are
+#define HEADER_BYTES (4 * sizeof (unsigned int) + 2)
+// bytes of the bitmap with the valid flags of the records
+#define BITMAP_BYTES ((MAX_RECORDS_PER_BLOCK + 7) / 8)
+
+// state of a compressed file
+
+struct codecFile {
+    bool writing;
+    // the offset of each encoded block in the file
+    uint64_t *offsets;
+    uint count;
+    uint capacity;
+    // where the index starts, which is where the last block ends
+    uint64_t end;
+    // the id of the next block of a sequential read
+    uint position;
+    // space for one encoded block
+    unsigned char *scratch;
+};
+
+static bool compressionEnabled = false;
+static codecFile *codecFiles[MAX_CODEC_FILES];
+
+void setTempCompression(bool enabled) {
+    compressionEnabled = enabled;
+}
+
+bool isCompressed(int fd) {
+    return fd >= 0 && fd < MAX_CODEC_FILES && codecFiles[fd];
+}
+
+// varints of 7 bits per byte. signed differences are zigzag encoded first,
+// so that small negative values take few bytes as well
+
+inline unsigned char *putVarint(unsigned char *out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+    return out;
+}
+
+inline unsigned char *getVarint(unsigned char *in, uint32_t &value) {
+    value = 0;
+    uint shift = 0;
+    while (*in & 0x80) {
+        value |= (uint32_t) (*in++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= (uint32_t) (*in++) << shift;
+    return in;
+}
+
+inline uint32_t zigzag(uint32_t current, uint32_t previous) {
+    int32_t difference = (int32_t) (current - previous);
+    return ((uint32_t) difference << 1) ^ (uint32_t) (difference >> 31);
+}
+
+inline uint32_t unzigzag(uint32_t value, uint32_t previous) {
+    int32_t difference = (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+    return previous + (uint32_t) difference;
+}
+
+uint encodeBlock(block_t *block, unsigned char *out) {
+    unsigned char *start = out;
+    memcpy(out, &(*block).blockid, sizeof (unsigned int));
+    memcpy(out + 4, &(*block).nreserved, sizeof (unsigned int));
+    memcpy(out + 8, &(*block).next_blockid, sizeof (unsigned int));
+    memcpy(out + 12, &(*block).dummy, sizeof (unsigned int));
+    out[16] = (*block).valid;
+    out[17] = (*block).misc;
+    out += HEADER_BYTES;
+
+    unsigned char *bitmap = out;
+    memset(bitmap, 0, BITMAP_BYTES);
+    out += BITMAP_BYTES;
+
+    uint32_t recid = 0, num = 0;
+    const char *str = "";
+    uint strLength = 0;
+    for (uint i = 0; i < MAX_RECORDS_PER_BLOCK; i++) {
+        record_t *rec = &(*block).entries[i];
+        if (!rec->valid) {
+            continue;
+        }
+        bitmap[i / 8] |= 1 << (i % 8);
+        out = putVarint(out, zigzag(rec->recid, recid));
+        out = putVarint(out, zigzag(rec->num, num));
+        recid = rec->recid;
+        num = rec->num;
+
+        uint length = strnlen(rec->str, STR_LENGTH);
+        uint shared = 0;
+        while (shared < length && shared < strLength && rec->str[shared] == str[shared]) {
+            shared += 1;
+        }
+        *out++ = shared;
+        *out++ = length - shared;
+        memcpy(out, rec->str + shared, length - shared);
+        out += length - shared;
+        str = rec->str;
+        strLength = length;
+    }
+    return out - start;
+}
+
+void decodeBlock(unsigned char *in, block_t *block) {
+    memcpy(&(*block).blockid, in, sizeof (unsigned int));
+    memcpy(&(*block).nreserved, in + 4, sizeof (unsigned int));
+    memcpy(&(*block).next_blockid, in + 8, sizeof (unsigned int));
+    memcpy(&(*block).dummy, in + 12, sizeof (unsigned int));
+    (*block).valid = in[16];
+    (*block).misc = in[17];
+    in += HEADER_BYTES;
+
+    unsigned char *bitmap = in;
+    in += BITMAP_BYTES;
+
+    uint32_t recid = 0, num = 0;
+    const char *str = "";
+    for (uint i = 0; i < MAX_RECORDS_PER_BLOCK; i++) {
+        record_t *rec = &(*block).entries[i];
+        if (!(bitmap[i / 8] & (1 << (i % 8)))) {
+            rec->valid = false;
+            continue;
+        }
+        uint32_t value;
+        in = getVarint(in, value);
+        recid = rec->recid = unzigzag(value, recid);
+        in = getVarint(in, value);
+        num = rec->num = unzigzag(value, num);
+
+        uint shared = *in++;
+        uint suffix = *in++;
+        memmove(rec->str, str, shared);
+        memcpy(rec->str + shared, in, suffix);
+        in += suffix;
+        memset(rec->str + shared + suffix, 0, STR_LENGTH - shared - suffix);
+        rec->valid = true;
+        str = rec->str;
+    }
+}
+
+// the file is read and written through the O_DIRECT bounce buffer if it was
+// opened with it
+
+inline void rawWrite(int fd, const void *data, size_t bytes) {
+    if (isDirect(fd)) {
+        directWrite(fd, data, bytes);
+    } else {
+        write(fd, data, bytes);
+        countIo(fd, -1, bytes, true);
+        countSyscall();
+    }
+}
+
+inline ssize_t rawPread(int fd, void *data, size_t bytes, off_t offset) {
+    if (isDirect(fd)) {
+        return directPread(fd, data, bytes, offset);
+    }
+    ssize_t got = pread(fd, data, bytes, offset);
+    countIo(fd, offset, got > 0 ? got : 0, false);
+    countSyscall();
+    return got;
+}
+
+codecFile *newCodecFile(int fd, bool writing) {
+    codecFile *file = (codecFile*) malloc(sizeof (codecFile));
+    file->writing = writing;
+    file->count = 0;
+    file->capacity = 64;
+    file->offsets = (uint64_t*) malloc(file->capacity * sizeof (uint64_t));
+    file->end = 0;
+    file->position = 0;
+    file->scratch = (unsigned char*) malloc(2 * sizeof (block_t));
+    codecFiles[fd] = file;
+    return file;
+}
+
+void freeCodecFile(int fd) {
+    codecFile *file = codecFiles[fd];
+    free(file->offsets);
+    free(file->scratch);
+    free(file);
+    codecFiles[fd] = NULL;
+}
+
+// reads the index at the end of a compressed file. returns false if the
+// file was not written compressed
+
+bool readIndex(int fd) {
+    struct stat st;
+    fstat(fd, &st);
+    unsigned char footer[16];
+    if (st.st_size < 16 || rawPread(fd, footer, 16, st.st_size - 16) != 16) {
+        return false;
+    }
+    uint32_t magic, count;
+    uint64_t end;
+    memcpy(&end, footer, 8);
+    memcpy(&count, footer + 8, 4);
+    memcpy(&magic, footer + 12, 4);
+    if (magic != CODEC_MAGIC || end + count * sizeof (uint64_t) + 16 != (uint64_t) st.st_size) {
+        return false;
+    }
+    codecFile *file = newCodecFile(fd, false);
+    file->capacity = count + 1;
+    file->offsets = (uint64_t*) realloc(file->offsets, file->capacity * sizeof (uint64_t));
+    rawPread(fd, file->offsets, count * sizeof (uint64_t), end);
+    file->count = count;
+    file->end = end;
+    return true;
+}
+
+int openTemp(char *filename, int flags, bool compress) {
+    int fd = openFile(filename, flags);
+    if (fd < 0 || fd >= MAX_CODEC_FILES) {
+        return fd;
+    }
+    if ((flags & O_ACCMODE) == O_RDONLY) {
+        readIndex(fd);
+    } else if (compressionEnabled && compress) {
+        newCodecFile(fd, true);
+    }
+    return fd;
+}
+
+void closeTemp(int fd) {
+    if (isCompressed(fd)) {
+        codecFile *file = codecFiles[fd];
+        if (file->writing) {
+            unsigned char footer[16];
+            uint32_t magic = CODEC_MAGIC;
+            memcpy(footer, &file->end, 8);
+            memcpy(footer + 8, &file->count, 4);
+            memcpy(footer + 12, &magic, 4);
+            rawWrite(fd, file->offsets, file->count * sizeof (uint64_t));
+            rawWrite(fd, footer, 16);
+        }
+        freeCodecFile(fd);
+    }
+    closeFile(fd);
+}
+
+void compressedWrite(int fd, block_t *buffer, uint size) {
+    codecFile *file = codecFiles[fd];
+    for (uint i = 0; i < size; i++) {
+        if (file->count == file->capacity) {
+            file->capacity *= 2;
+            file->offsets = (uint64_t*) realloc(file->offsets, file->capacity * sizeof (uint64_t));
+        }
+        uint bytes = encodeBlock(buffer + i, file->scratch);
+        rawWrite(fd, file->scratch, bytes);
+        file->offsets[file->count++] = file->end;
+        file->end += bytes;
+    }
+}
+
+// blocks after the end of the file are left as they are, like pread does
+
+void compressedPread(int fd, block_t *buffer, uint offset, uint size) {
+    codecFile *file = codecFiles[fd];
+    for (uint i = 0; i < size && offset + i < file->count; i++) {
+        uint64_t start = file->offsets[offset + i];
+        uint64_t end = file->end;
+        if (offset + i + 1 < file->count) {
+            end = file->offsets[offset + i + 1];
+        }
+        rawPread(fd, file->scratch, end - start, start);
+        decodeBlock(file->scratch, buffer + i);
+    }
+}
+
+void compressedRead(int fd, block_t *buffer, uint size) {
+    codecFile *file = codecFiles[fd];
+    compressedPread(fd, buffer, file->position, size);
+    file->position += size;
+}
+
+uint finishTemp(char *tmpFile, char *filename, block_t *block) {
+    int in = openTemp(tmpFile, O_RDONLY, false);
+    uint count;
+    if (isCompressed(in)) {
+        count = codecFiles[in]->count;
+    } else {
+        // the temp file may be on another file system than filename, and
+        // then it can not be renamed but is copied
+        if (rename(tmpFile, filename) == 0) {
+            closeTemp(in);
+            return 0;
+        }
+        struct stat st;
+        fstat(in, &st);
+        count = st.st_size / sizeof (block_t);
+    }
+    uint ios = 0;
+    int out = openFile(filename, O_WRONLY | O_CREAT | O_TRUNC);
+    for (uint i = 0; i < count; i++) {
+        ios += preadBlocks(in, block, i, 1);
+        ios += writeBlocks(out, block, 1);
+    }
+    closeFile(out);
+    closeTemp(in);
+    remove(tmpFile);
+    return ios;
+}
@@ -0,0 +1,74 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef BLOCKCODEC_H
+#define	BLOCKCODEC_H
+
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// temp files can be written compressed. each block is encoded on its own:
+// the valid flags of its records are kept as a bitmap, recid and num as
+// varints of the difference from the previous valid record (small, since
+// the records are sorted) and str as the length of the prefix it shares with
+// the previous str followed by the rest of its characters (front coding).
+// an index with the offset of each encoded block is written at the end of
+// the file, so blocks can still be read by their id
+
+#define CODEC_MAGIC 0x434b4c42
+
+// when enabled, temp files opened with openTemp for writing are compressed.
+// disabled by default
+void setTempCompression(bool enabled);
+
+// encodes block to out, which must have space for 2 blocks.
+// returns the number of bytes used
+uint encodeBlock(block_t *block, unsigned char *out);
+
+// decodes a block encoded with encodeBlock
+void decodeBlock(unsigned char *in, block_t *block);
+
+// opens a temp file, with the same flags as openFile. a file opened for
+// writing is compressed if compression is enabled and compress is true.
+// a file opened for reading is decompressed if it was written compressed
+int openTemp(char *filename, int flags, bool compress);
+
+// closes a file opened with openTemp. the index of a compressed file is
+// written before it is closed
+void closeTemp(int fd);
+
+// true if fd was opened with openTemp and is compressed
+bool isCompressed(int fd);
+
+// the equivalents of writeBlocks, readBlocks and preadBlocks for compressed files
+void compressedWrite(int fd, block_t *buffer, uint size);
+
+void compressedRead(int fd, block_t *buffer, uint size);
+
+void compressedPread(int fd, block_t *buffer, uint offset, uint size);
+
+// renames a temp file to filename. if the temp file is compressed, or on
+// another file system, it is decompressed or copied to filename instead,
+// using block of memory. returns the ios of the copy
+uint finishTemp(char *tmpFile, char *filename, block_t *block);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include "blockScan.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "bufferOps.h"
+#include "fileOps.h"
+
+static scanBackend backendUsed = SCAN_READ;
+static int backendOptions = 0;
+
+void setScanBackend(scanBackend backend, int options) {
+    backendUsed = backend;
+    backendOptions = options;
+}
+
+// opens a file for scanning. if mmap is used but the file cannot be mapped
+// (eg it is empty), falls back to read
+
+bool openScan(blockScan &scan, char *filename) {
+    scan.fd = open(filename, O_RDONLY, S_IRWXU);
+    scan.map = NULL;
+    scan.next = 0;
+    if (scan.fd < 0) {
+        scan.size = 0;
+        return false;
+    }
+    scan.size = getSize(filename);
+
+    if (backendUsed == SCAN_MMAP && scan.size != 0) {
+        int flags = MAP_PRIVATE;
+        if (backendOptions & SCAN_POPULATE) {
+            flags |= MAP_POPULATE;
+        }
+        void *map = mmap(NULL, scan.size * sizeof (block_t), PROT_READ, flags, scan.fd, 0);
+        countSyscall();
+        if (map != MAP_FAILED) {
+            // the kernel reads ahead aggressively and drops pages already scanned
+            madvise(map, scan.size * sizeof (block_t), MADV_SEQUENTIAL);
+            countSyscall();
+            scan.map = (block_t*) map;
+        }
+    }
+    return true;
+}
+
+// returns the next block of the scan
+
+block_t *nextBlock(blockScan &scan, block_t *slot, uint *nios) {
+    (*nios) += 1;
+    if (scan.map && scan.next < scan.size) {
+        // the block is read from the mapping, but the scan still proceeds
+        // block by block, so the io is counted the same way
+        countIo(scan.fd, -1, sizeof (block_t), false);
+        return scan.map + scan.next++;
+    }
+    readBlocks(scan.fd, slot, 1);
+    scan.next += 1;
+    return slot;
+}
+
+// closes the scan
+
+void closeScan(blockScan &scan) {
+    if (scan.map) {
+        munmap(scan.map, scan.size * sizeof (block_t));
+        countSyscall();
+        scan.map = NULL;
+    }
+    if (scan.fd >= 0) {
+        close(scan.fd);
+    }
+}
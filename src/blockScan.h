@@ -0,0 +1,71 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef BLOCKSCAN_H
+#define	BLOCKSCAN_H
+
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// backends that can be used to scan a file block by block
+// SCAN_READ: each block is copied with read to a block of the buffer
+// SCAN_MMAP: the file is mapped and each block is a view of the page cache
+
+enum scanBackend {
+    SCAN_READ,
+    SCAN_MMAP
+};
+
+// options for SCAN_MMAP
+// SCAN_POPULATE: the whole file is faulted in when the scan is opened
+
+#define SCAN_POPULATE 1
+
+// sets the backend used by all the scans opened from now on.
+// the default is SCAN_READ
+void setScanBackend(scanBackend backend, int options);
+
+// a sequential scan of a file
+
+typedef struct {
+    int fd;
+    // the mapped file, or NULL if blocks are copied with read
+    block_t *map;
+    // the size of the file in blocks
+    uint size;
+    // the id of the next block to be returned
+    uint next;
+} blockScan;
+
+// opens filename for scanning. returns false if it cannot be opened
+bool openScan(blockScan &scan, char *filename);
+
+// returns the next block of the scan and increases nios by one.
+// slot is the buffer block reserved for the scan. blocks are copied to it if the
+// file is not mapped, so the memory used is the same with both backends.
+// the block returned must not be modified
+block_t *nextBlock(blockScan &scan, block_t *slot, uint *nios);
+
+// closes the scan and unmaps the file
+void closeScan(blockScan &scan);
+
+#endif
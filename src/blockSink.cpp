@@ -0,0 +1,119 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include <pthread.h>
+
+#include "dbtproj.h"
+#include "bufferOps.h"
+#include "blockSink.h"
+
+uint putFile(blockSink *sink, block_t *block) {
+    return writeBlocks((*sink).fd, block, 1);
+}
+
+blockSink fileSink(int fd) {
+    blockSink sink;
+    sink.put = putFile;
+    sink.fd = fd;
+    sink.state = NULL;
+    return sink;
+}
+
+uint putCallback(blockSink *sink, block_t *block) {
+    sinkCallback *callback = (sinkCallback*) (*sink).state;
+    syncFlags(block, 1);
+    (*callback).callback(block, (*callback).arg);
+    return 0;
+}
+
+blockSink callbackSink(sinkCallback *callback) {
+    blockSink sink;
+    sink.put = putCallback;
+    sink.fd = -1;
+    sink.state = callback;
+    return sink;
+}
+
+void initRing(blockRing &ring, block_t *blocks, uint size) {
+    ring.blocks = blocks;
+    ring.size = size;
+    ring.puts = 0;
+    ring.takes = 0;
+    ring.closed = false;
+    pthread_mutex_init(&ring.lock, NULL);
+    pthread_cond_init(&ring.changed, NULL);
+}
+
+uint putRing(blockSink *sink, block_t *block) {
+    blockRing &ring = *(blockRing*) (*sink).state;
+    syncFlags(block, 1);
+    pthread_mutex_lock(&ring.lock);
+    while (ring.puts - ring.takes == ring.size) {
+        pthread_cond_wait(&ring.changed, &ring.lock);
+    }
+    pthread_mutex_unlock(&ring.lock);
+    // only the producer writes to the free blocks of the ring
+    ring.blocks[ring.puts % ring.size] = *block;
+    pthread_mutex_lock(&ring.lock);
+    ring.puts += 1;
+    pthread_cond_broadcast(&ring.changed);
+    pthread_mutex_unlock(&ring.lock);
+    return 0;
+}
+
+blockSink ringSink(blockRing &ring) {
+    blockSink sink;
+    sink.put = putRing;
+    sink.fd = -1;
+    sink.state = &ring;
+    return sink;
+}
+
+void closeRing(blockRing &ring) {
+    pthread_mutex_lock(&ring.lock);
+    ring.closed = true;
+    pthread_cond_broadcast(&ring.changed);
+    pthread_mutex_unlock(&ring.lock);
+}
+
+bool takeBlock(blockRing &ring, block_t *block) {
+    pthread_mutex_lock(&ring.lock);
+    while (ring.puts == ring.takes && !ring.closed) {
+        pthread_cond_wait(&ring.changed, &ring.lock);
+    }
+    if (ring.puts == ring.takes) {
+        pthread_mutex_unlock(&ring.lock);
+        return false;
+    }
+    pthread_mutex_unlock(&ring.lock);
+    // only the consumer reads the full blocks of the ring
+    *block = ring.blocks[ring.takes % ring.size];
+    pthread_mutex_lock(&ring.lock);
+    ring.takes += 1;
+    pthread_cond_broadcast(&ring.changed);
+    pthread_mutex_unlock(&ring.lock);
+    return true;
+}
+
+void destroyRing(blockRing &ring) {
+    pthread_mutex_destroy(&ring.lock);
+    pthread_cond_destroy(&ring.changed);
+}
@@ -0,0 +1,93 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef BLOCKSINK_H
+#define	BLOCKSINK_H
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// receives the output blocks of an operator, one at a time. put is called with
+// each block of the output, in order. the block holds its records in its first
+// nreserved entries, with their flags up to date, and may be changed by the
+// operator once put returns. put returns the number of ios it did
+
+typedef struct blockSink {
+    uint (*put)(blockSink *sink, block_t *block);
+    // the file of a file sink
+    int fd;
+    // the state of the other sinks
+    void *state;
+} blockSink;
+
+inline uint putBlock(blockSink *sink, block_t *block) {
+    return (*sink).put(sink, block);
+}
+
+// returns a sink that writes the blocks to the file described by fd. this is
+// how the operators write their outfile
+blockSink fileSink(int fd);
+
+// state of a callback sink
+
+typedef struct {
+    void (*callback)(const block_t *block, void *arg);
+    void *arg;
+} sinkCallback;
+
+// returns a sink that calls (*callback).callback with each block and (*callback).arg.
+// callback must stay allocated while the sink is used
+blockSink callbackSink(sinkCallback *callback);
+
+// a ring of blocks, through which the output of an operator is passed to a
+// consumer running on another thread. put copies each block to the ring,
+// waiting while it is full, and takeBlock copies them out in order
+
+typedef struct {
+    block_t *blocks;
+    uint size;
+    // number of blocks put and taken so far
+    uint puts;
+    uint takes;
+    // true once the output is over
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} blockRing;
+
+// creates a ring over the size blocks starting from blocks
+void initRing(blockRing &ring, block_t *blocks, uint size);
+
+// returns a sink that puts the blocks on ring
+blockSink ringSink(blockRing &ring);
+
+// marks the output as over, once the operator has returned
+void closeRing(blockRing &ring);
+
+// copies the next block of ring to block, waiting for it. returns false if
+// ring is closed and there are no blocks left
+bool takeBlock(blockRing &ring, block_t *block);
+
+void destroyRing(blockRing &ring);
+
+#endif
@@ -24,17 +24,90 @@
 
 #include <fcntl.h> 
 #include <unistd.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 #include "dbtproj.h"
+#include "directIO.h"
+#include "blockCodec.h"
+#include "opStats.h"
+
+// the records of a block in memory are valid either by their flags, like in the
+// files, or by position. a block whose dummy field is PREFIX_VALID is in prefix
+// form: exactly its first nreserved records are valid, whatever their flags say.
+// blocks that are filled from the start (output blocks, sorted segments) are
+// kept in prefix form, so they are emptied in O(1) and scanned without reading
+// the flags. the flags are brought up to date and the block leaves prefix form
+// when it is written, so the files always hold valid flags and never the
+// marker, which would otherwise be trusted over the flags when read back
+
+#define PREFIX_VALID 0x50524658
+
+// bitmap of the valid records of a block, one bit per record
+
+typedef struct {
+    uint64_t bits[2];
+} recordMask;
+
+// returns the bitmap of the valid records of a block. it is built from
+// nreserved for a block in prefix form, otherwise from the flags
+
+inline recordMask validRecords(const block_t *block) {
+    recordMask mask;
+    if ((*block).dummy == PREFIX_VALID) {
+        uint n = (*block).nreserved < MAX_RECORDS_PER_BLOCK ? (*block).nreserved : MAX_RECORDS_PER_BLOCK;
+        mask.bits[0] = n >= 64 ? ~0ULL : (1ULL << n) - 1;
+        mask.bits[1] = n > 64 ? (1ULL << (n - 64)) - 1 : 0;
+        return mask;
+    }
+    mask.bits[0] = 0;
+    mask.bits[1] = 0;
+    for (int i = 0; i < MAX_RECORDS_PER_BLOCK; i++) {
+        if ((*block).entries[i].valid) {
+            mask.bits[i / 64] |= 1ULL << (i % 64);
+        }
+    }
+    return mask;
+}
 
-// empties a block
+// returns the index of the first valid record left in mask and removes it,
+// or -1 if there is none
 
-inline void emptyBlock(block_t *buffer) {
-    for (int i = 0; i < MAX_RECORDS_PER_BLOCK; i++) {
-        (*buffer).entries[i].valid = false;
+inline int nextValid(recordMask &mask) {
+    if (mask.bits[0]) {
+        int i = __builtin_ctzll(mask.bits[0]);
+        mask.bits[0] &= mask.bits[0] - 1;
+        return i;
     }
+    if (mask.bits[1]) {
+        int i = __builtin_ctzll(mask.bits[1]);
+        mask.bits[1] &= mask.bits[1] - 1;
+        return 64 + i;
+    }
+    return -1;
+}
+
+// writes back the flags of the blocks in prefix form: the records after the
+// first nreserved are marked as invalid. the blocks then leave prefix form,
+// since their flags tell the same, so the marker is never written to a file
+
+inline void syncFlags(block_t *buffer, uint size) {
+    for (uint b = 0; b < size; b++) {
+        if (buffer[b].dummy != PREFIX_VALID) {
+            continue;
+        }
+        for (uint i = buffer[b].nreserved; i < MAX_RECORDS_PER_BLOCK; i++) {
+            buffer[b].entries[i].valid = false;
+        }
+        buffer[b].dummy = 0;
+    }
+}
+
+// empties a block, leaving it in prefix form
+
+inline void emptyBlock(block_t *buffer) {
     (*buffer).nreserved = 0;
+    (*buffer).dummy = PREFIX_VALID;
 }
 
 // empties the whole buffer
@@ -50,8 +123,15 @@ inline void emptyBuffer(block_t *buffer, uint size) {
 // starting from pointer buffer
 
 inline uint writeBlocks(char* filename, block_t *buffer, uint size) {
+    syncFlags(buffer, size);
+    if (directIOEnabled() && directAppend(filename, buffer, size * sizeof (block_t))) {
+        return size;
+    }
     int fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, S_IRWXU);
     write(fd, buffer, size * sizeof (block_t));
+    countIo(fd, -1, size * sizeof (block_t), true);
+    countSyscall();
+    forgetFile(fd);
     close(fd);
     return size;
 }
@@ -60,7 +140,18 @@ inline uint writeBlocks(char* filename, block_t *buffer, uint size) {
 // by fd file descriptor
 
 inline uint writeBlocks(int fd, block_t *buffer, uint size) {
+    syncFlags(buffer, size);
+    if (isCompressed(fd)) {
+        compressedWrite(fd, buffer, size);
+        return size;
+    }
+    if (isDirect(fd)) {
+        directWrite(fd, buffer, size * sizeof (block_t));
+        return size;
+    }
     write(fd, buffer, size * sizeof (block_t));
+    countIo(fd, -1, size * sizeof (block_t), true);
+    countSyscall();
     return size;
 }
 
@@ -68,7 +159,10 @@ inline uint writeBlocks(int fd, block_t *buffer, uint size) {
 
 inline uint readBlocks(char* filename, block_t *buffer, uint size) {
     int fd = open(filename, O_RDONLY, S_IRWXU);
-    read(fd, buffer, size * sizeof (block_t));
+    ssize_t got = read(fd, buffer, size * sizeof (block_t));
+    countIo(fd, -1, got > 0 ? got : 0, false);
+    countSyscall();
+    forgetFile(fd);
     close(fd);
     return size;
 }
@@ -76,14 +170,34 @@ inline uint readBlocks(char* filename, block_t *buffer, uint size) {
 // reads size blocks to buffer
 
 inline uint readBlocks(int fd, block_t *buffer, uint size) {
-    read(fd, buffer, size * sizeof (block_t));
+    if (isCompressed(fd)) {
+        compressedRead(fd, buffer, size);
+        return size;
+    }
+    if (isDirect(fd)) {
+        directRead(fd, buffer, size * sizeof (block_t));
+        return size;
+    }
+    ssize_t got = read(fd, buffer, size * sizeof (block_t));
+    countIo(fd, -1, got > 0 ? got : 0, false);
+    countSyscall();
     return size;
 }
 
 // reads size blocks to buffer from a specific point (offset) of the file
 
 inline uint preadBlocks(int fd, block_t *buffer, uint offset, uint size) {
-    pread(fd, buffer, size * sizeof (block_t), offset * sizeof (block_t));
+    if (isCompressed(fd)) {
+        compressedPread(fd, buffer, offset, size);
+        return size;
+    }
+    if (isDirect(fd)) {
+        directPread(fd, buffer, size * sizeof (block_t), (off_t) offset * sizeof (block_t));
+        return size;
+    }
+    ssize_t got = pread(fd, buffer, size * sizeof (block_t), (off_t) offset * sizeof (block_t));
+    countIo(fd, (off_t) offset * sizeof (block_t), got > 0 ? got : 0, false);
+    countSyscall();
     return size;
 }
 
@@ -0,0 +1,142 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include "bufferPool.h"
+
+#include <stdlib.h>
+
+#include "bufferOps.h"
+
+static thread_local uint totalHits = 0;
+static thread_local uint totalMisses = 0;
+
+// returns the bucket of a page in the hash index of the frames
+
+inline uint bucketOf(bufferPool &pool, int fd, uint pageId) {
+    return (pageId * 2654435761u + fd) % pool.bucketCount;
+}
+
+void initPool(bufferPool &pool, block_t *frames, uint size) {
+    pool.frames = frames;
+    pool.size = size;
+    pool.fds = (int*) malloc(size * sizeof (int));
+    pool.pageIds = (uint*) malloc(size * sizeof (uint));
+    pool.pins = (uint*) malloc(size * sizeof (uint));
+    pool.referenced = (bool*) malloc(size * sizeof (bool));
+    pool.next = (int*) malloc(size * sizeof (int));
+    for (uint i = 0; i < size; i++) {
+        pool.fds[i] = -1;
+        pool.pins[i] = 0;
+        pool.referenced[i] = false;
+    }
+    pool.bucketCount = 2 * size;
+    pool.buckets = (int*) malloc(pool.bucketCount * sizeof (int));
+    for (uint i = 0; i < pool.bucketCount; i++) {
+        pool.buckets[i] = -1;
+    }
+    pool.hand = 0;
+    pool.hits = 0;
+    pool.misses = 0;
+}
+
+// removes a frame from the hash index
+
+void unlinkFrame(bufferPool &pool, uint frame) {
+    int *link = &pool.buckets[bucketOf(pool, pool.fds[frame], pool.pageIds[frame])];
+    while (*link != (int) frame) {
+        link = &pool.next[*link];
+    }
+    *link = pool.next[frame];
+}
+
+// advances the clock hand until an unpinned frame that has not been used
+// since the hand last passed is found. returns -1 if all frames are pinned
+
+int chooseVictim(bufferPool &pool) {
+    // after two full circles every unpinned frame has lost its second chance
+    for (uint i = 0; i < 2 * pool.size; i++) {
+        uint frame = pool.hand;
+        pool.hand = (pool.hand + 1) % pool.size;
+        if (pool.pins[frame] != 0) {
+            continue;
+        }
+        if (pool.referenced[frame]) {
+            pool.referenced[frame] = false;
+            continue;
+        }
+        return frame;
+    }
+    return -1;
+}
+
+block_t *pinBlock(bufferPool &pool, int fd, uint pageId, uint *nios) {
+    uint bucket = bucketOf(pool, fd, pageId);
+    for (int frame = pool.buckets[bucket]; frame != -1; frame = pool.next[frame]) {
+        if (pool.fds[frame] == fd && pool.pageIds[frame] == pageId) {
+            pool.hits += 1;
+            pool.pins[frame] += 1;
+            pool.referenced[frame] = true;
+            return pool.frames + frame;
+        }
+    }
+
+    int frame = chooseVictim(pool);
+    if (frame == -1) {
+        return NULL;
+    }
+    if (pool.fds[frame] != -1) {
+        unlinkFrame(pool, frame);
+    }
+    pool.misses += 1;
+    (*nios) += preadBlocks(fd, pool.frames + frame, pageId, 1);
+    pool.fds[frame] = fd;
+    pool.pageIds[frame] = pageId;
+    pool.pins[frame] = 1;
+    pool.referenced[frame] = true;
+    pool.next[frame] = pool.buckets[bucket];
+    pool.buckets[bucket] = frame;
+    return pool.frames + frame;
+}
+
+void unpinBlock(bufferPool &pool, block_t *frame) {
+    uint i = frame - pool.frames;
+    if (pool.pins[i] != 0) {
+        pool.pins[i] -= 1;
+    }
+}
+
+void destroyPool(bufferPool &pool) {
+    totalHits += pool.hits;
+    totalMisses += pool.misses;
+    free(pool.fds);
+    free(pool.pageIds);
+    free(pool.pins);
+    free(pool.referenced);
+    free(pool.next);
+    free(pool.buckets);
+}
+
+void poolStats(uint *hits, uint *misses) {
+    (*hits) = totalHits;
+    (*misses) = totalMisses;
+    totalHits = 0;
+    totalMisses = 0;
+}
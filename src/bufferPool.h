@@ -0,0 +1,75 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef BUFFERPOOL_H
+#define	BUFFERPOOL_H
+
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// a buffer pool over a number of blocks of the buffer (frames). blocks of a
+// file are pinned by their id (page id) and are only read if they are not
+// already on a frame. when a block has to be read, a frame whose block is not
+// pinned is chosen with the clock algorithm: the frames are visited in a
+// circle and a recently used frame gets a second chance before it is replaced
+
+typedef struct {
+    block_t *frames;
+    uint size;
+    // for each frame, the file descriptor and id of the block it holds
+    // (fd is -1 if it holds none), how many times it is pinned, and whether
+    // it has been used since the clock hand last passed
+    int *fds;
+    uint *pageIds;
+    uint *pins;
+    bool *referenced;
+    // the frame the clock hand points to
+    uint hand;
+    // hash index of the frames by page id. each bucket is a list of frames
+    // linked through next, with -1 at its end
+    int *buckets;
+    int *next;
+    uint bucketCount;
+    uint hits;
+    uint misses;
+} bufferPool;
+
+// creates a pool over the size blocks of buffer starting from frames
+void initPool(bufferPool &pool, block_t *frames, uint size);
+
+// returns the frame holding block pageId of the file described by fd, reading
+// it if needed (one io added to nios), and pins it so that it is not replaced.
+// returns NULL if all frames are pinned
+block_t *pinBlock(bufferPool &pool, int fd, uint pageId, uint *nios);
+
+// unpins a block pinned with pinBlock
+void unpinBlock(bufferPool &pool, block_t *frame);
+
+// frees the memory allocated for the pool and adds its hits and misses to
+// the totals of the calling thread
+void destroyPool(bufferPool &pool);
+
+// returns the hits and misses of the pools destroyed by the calling thread
+// since the last call
+void poolStats(uint *hits, uint *misses);
+
+#endif
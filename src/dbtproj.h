@@ -118,4 +118,146 @@ void MergeJoin(char *infile1, char *infile2, unsigned char field, block_t *buffe
 void HashJoin(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios);
 
 
+/* ----------------------------------------------------------------------------------------------------------------------
+   infile1: the name of the first input file
+   infile2: the name of the second input file
+   field: which field will be used for the join: 0 is for recid, 1 is for num, 2 is for str and 3 is for both num and str
+   buffer: pointer to memory buffer
+   nmem_blocks: number of blocks in memory
+   outfile: the name of the output file
+   nres: number of pairs in output (this should be set by you)
+   nios: number of IOs performed, including the ones for sampling (this should be set by you)
+
+   samples both files, predicts the cost of MergeJoin and HashJoin and calls the cheaper one
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void Join(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios);
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   infile1: the name of the first input file
+   infile2: the name of the second input file
+   field: which field will be used: 0 is for recid, 1 is for num, 2 is for str and 3 is for both num and str
+   buffer: pointer to memory buffer
+   nmem_blocks: number of blocks in memory
+   outfile: the name of the output file
+   nres: number of pairs in output (this should be set by you)
+   nios: number of IOs performed (this should be set by you)
+   sorts both files, eliminates their duplicates and merge joins them as a pipeline: the last merge of each sort
+   feeds its dedup and the dedups feed the join block by block, with no intermediate files
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void SortDedupJoin(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios);
+
+struct blockSink;
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   sink: receives the output blocks (see blockSink.h)
+   the same as MergeSort, EliminateDuplicates, MergeJoin and HashJoin, but each output block is passed to sink
+   instead of being written to an output file. the outfile versions use a sink that writes to the outfile
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void MergeSortSink(char *infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nsorted_segs, unsigned int *npasses, unsigned int *nios);
+
+void EliminateDuplicatesSink(char *infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nunique, unsigned int *nios);
+
+void MergeJoinSink(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios);
+
+void HashJoinSink(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios);
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   limit: number of records wanted
+   the same as MergeSort and MergeSortSink, but only the first limit records of the sorted infile are output.
+   if they fit on half the buffer, infile is scanned once. otherwise each sorted segment is cut to its first limit
+   records before they are merged
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void MergeSortLimit(char *infile, unsigned char field, unsigned int limit, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nsorted_segs, unsigned int *npasses, unsigned int *nios);
+
+void MergeSortLimitSink(char *infile, unsigned char field, unsigned int limit, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nsorted_segs, unsigned int *npasses, unsigned int *nios);
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   the same as MergeSort and MergeSortSink, but infile is sorted by distribution: a sample of it is sorted to choose
+   splitters, its records are scattered to files of ordered ranges of values in one pass, and then each range is
+   sorted on its own (in memory if it fits the buffer) and output in order.
+   nsorted_segs: number of sorted segments produced for all the ranges
+   npasses: 1 for the scatter, plus the passes of the range that needed the most
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void DistributionSort(char *infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nsorted_segs, unsigned int *npasses, unsigned int *nios);
+
+void DistributionSortSink(char *infile, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nsorted_segs, unsigned int *npasses, unsigned int *nios);
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   infile: the name of the input file
+   field: which field the records are grouped on: 0 is for recid, 1 is for num, 2 is for str and 3 is for both num and str
+   aggregation: the aggregate of each group: 0 is for count, 1 is for sum of num, 2 is for min of num and 3 is for max of num
+   buffer: pointer to memory buffer
+   nmem_blocks: number of blocks in memory
+   outfile: the name of the output file
+   ngroups: number of groups in output (this should be set by you)
+   nios: number of IOs performed (this should be set by you)
+   each group is output as one of its records, with recid set to the aggregate, or num if field is 0 (sums wrap around
+   like unsigned int). the groups are aggregated on the buffer with hashing and output in the order they were found if
+   they fit. otherwise the buffer is written whenever it is full of groups, sorted, and these runs are merged, with equal
+   groups combined on every pass, and output sorted on field
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void Aggregate(char *infile, unsigned char field, unsigned char aggregation, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *ngroups, unsigned int *nios);
+
+void AggregateSink(char *infile, unsigned char field, unsigned char aggregation, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *ngroups, unsigned int *nios);
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   anti: false for a semi-join, true for an anti-join
+   nres: number of records in output (this should be set by you)
+   the same as HashJoin and HashJoinSink, but instead of the pairs, each record of infile2 that has a matching record
+   on infile1 is output once, or with anti each record of infile2 that has none. a record is only compared up to its
+   first match
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void HashSemiJoin(char *infile1, char *infile2, unsigned char field, bool anti, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios);
+
+void HashSemiJoinSink(char *infile1, char *infile2, unsigned char field, bool anti, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios);
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   outer: the kind of outer join: 0 is for left, 1 is for right and 2 is for full
+   nres: number of pairs in output, including the ones with no match (this should be set by you)
+   the same as MergeJoin and MergeJoinSink, but the records of infile1 (left), infile2 (right) or both (full) that have
+   no matching record are output as well, paired with a null record (see nullRecord in recordOps.h). the record of
+   infile1 is always the first of each pair
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void MergeOuterJoin(char *infile1, char *infile2, unsigned char field, unsigned char outer, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios);
+
+void MergeOuterJoinSink(char *infile1, char *infile2, unsigned char field, unsigned char outer, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios);
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   delta: the largest difference of num for which two records are joined
+   the same as MergeJoin and MergeJoinSink, but the records are joined on num, with each pair of records whose num
+   differ by at most delta in output, the record of infile1 first. both files are sorted on num and the smaller one
+   is joined with the bigger through a window of its records that moves forward, in one merge pass
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void MergeBandJoin(char *infile1, char *infile2, unsigned int delta, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios);
+
+void MergeBandJoinSink(char *infile1, char *infile2, unsigned int delta, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios);
+
+/* ----------------------------------------------------------------------------------------------------------------------
+   infiles: the names of the input files
+   ninputs: number of input files, from 2 to MAX_RECORDS_PER_BLOCK
+   field: which field will be used for the join: 0 is for recid, 1 is for num, 2 is for str and 3 is for both num and str
+   buffer: pointer to memory buffer
+   nmem_blocks: number of blocks in memory, at least 3 and at least ninputs + 1
+   outfile: the name of the output file
+   nres: number of tuples in output (this should be set by you)
+   nios: number of IOs performed (this should be set by you)
+   joins all the files at once: each one is sorted once and then they are merged together. each tuple of records, one
+   of each file in order, with equal values is output as ninputs consecutive records. a tuple is never split between
+   two blocks, so blocks may have fewer than MAX_RECORDS_PER_BLOCK records
+   ----------------------------------------------------------------------------------------------------------------------
+ */
+void MultiMergeJoin(char **infiles, unsigned int ninputs, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios);
+
+void MultiMergeJoinSink(char **infiles, unsigned int ninputs, unsigned char field, block_t *buffer, unsigned int nmem_blocks, blockSink *sink, unsigned int *nres, unsigned int *nios);
+
+
 #endif
@@ -0,0 +1,227 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include "directIO.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "opStats.h"
+
+// files with a descriptor higher than this are opened without O_DIRECT
+#define MAX_DIRECT_FILES 1024
+
+// state of a file opened with O_DIRECT
+
+struct directFile {
+    // aligned bounce buffer
+    char *stage;
+    // the file offset of the first byte of stage. always aligned
+    off_t stageOffset;
+    // number of bytes in stage not yet written
+    size_t staged;
+    // the offset of the next sequential read
+    off_t position;
+    // the size of the file, counting the bytes not yet written
+    off_t size;
+    bool written;
+};
+
+static bool directEnabled = false;
+static directFile *directFiles[MAX_DIRECT_FILES];
+
+void setDirectIO(bool enabled) {
+    directEnabled = enabled;
+}
+
+bool directIOEnabled() {
+    return directEnabled;
+}
+
+bool isDirect(int fd) {
+    return fd >= 0 && fd < MAX_DIRECT_FILES && directFiles[fd];
+}
+
+// creates the state of a file opened with O_DIRECT
+
+directFile *newDirectFile(int fd) {
+    directFile *file = (directFile*) malloc(sizeof (directFile));
+    if (posix_memalign((void**) &file->stage, DIRECT_ALIGN, DIRECT_STAGE) != 0) {
+        free(file);
+        return NULL;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    file->size = st.st_size;
+    file->stageOffset = st.st_size - st.st_size % DIRECT_ALIGN;
+    file->staged = 0;
+    file->position = 0;
+    file->written = false;
+    directFiles[fd] = file;
+    return file;
+}
+
+// opens filename with O_DIRECT, falling back to a normal open if that is
+// not possible
+
+int openFile(char *filename, int flags) {
+    if (directEnabled) {
+        // the last partial page may have to be read back before it is
+        // rewritten, so files opened for writing are opened for reading as well
+        // O_APPEND is dropped, since pages are written at explicit offsets
+        int directFlags = (flags & ~O_APPEND) | O_DIRECT;
+        if ((flags & O_ACCMODE) == O_WRONLY) {
+            directFlags = (directFlags & ~O_ACCMODE) | O_RDWR;
+        }
+        int fd = open(filename, directFlags, S_IRWXU);
+        if (fd >= MAX_DIRECT_FILES || (fd >= 0 && !newDirectFile(fd))) {
+            close(fd);
+        } else if (fd >= 0) {
+            return fd;
+        }
+    }
+    return open(filename, flags, S_IRWXU);
+}
+
+// writes the whole pages of stage, or all of it padded with zeroes if
+// flushAll is true, and keeps the rest at its start
+
+void flushStage(int fd, directFile *file, bool flushAll) {
+    size_t bytes = file->staged - file->staged % DIRECT_ALIGN;
+    if (flushAll && bytes != file->staged) {
+        bytes += DIRECT_ALIGN;
+        memset(file->stage + file->staged, 0, bytes - file->staged);
+    }
+    if (bytes == 0) {
+        return;
+    }
+    pwrite(fd, file->stage, bytes, file->stageOffset);
+    countIo(fd, file->stageOffset, bytes, true);
+    countSyscall();
+    file->written = true;
+    if (flushAll) {
+        return;
+    }
+    memmove(file->stage, file->stage + bytes, file->staged - bytes);
+    file->staged -= bytes;
+    file->stageOffset += bytes;
+}
+
+void closeFile(int fd) {
+    if (isDirect(fd)) {
+        directFile *file = directFiles[fd];
+        if (file->staged != 0) {
+            flushStage(fd, file, true);
+        }
+        // drops the padding of the last page
+        if (file->written) {
+            ftruncate(fd, file->size);
+            countSyscall();
+        }
+        free(file->stage);
+        free(file);
+        directFiles[fd] = NULL;
+    }
+    forgetFile(fd);
+    close(fd);
+}
+
+// appends data to the file. the bytes of its last partial page are first read
+// back, so that the page can be rewritten whole
+
+ssize_t directWrite(int fd, const void *data, size_t bytes) {
+    directFile *file = directFiles[fd];
+    if (file->staged == 0 && file->size != file->stageOffset) {
+        pread(fd, file->stage, DIRECT_ALIGN, file->stageOffset);
+        countIo(fd, file->stageOffset, DIRECT_ALIGN, false);
+        countSyscall();
+        file->staged = file->size - file->stageOffset;
+    }
+    const char *from = (const char*) data;
+    size_t left = bytes;
+    while (left != 0) {
+        size_t copied = DIRECT_STAGE - file->staged;
+        if (copied > left) {
+            copied = left;
+        }
+        memcpy(file->stage + file->staged, from, copied);
+        file->staged += copied;
+        from += copied;
+        left -= copied;
+        flushStage(fd, file, false);
+    }
+    file->size += bytes;
+    return bytes;
+}
+
+// reads the aligned pages that contain the requested bytes to stage, and
+// copies the requested bytes from there
+
+ssize_t directPread(int fd, void *data, size_t bytes, off_t offset) {
+    directFile *file = directFiles[fd];
+    char *to = (char*) data;
+    size_t done = 0;
+    while (done < bytes) {
+        off_t from = offset + done;
+        off_t pageOffset = from - from % DIRECT_ALIGN;
+        size_t length = (from - pageOffset) + (bytes - done);
+        if (length % DIRECT_ALIGN != 0) {
+            length += DIRECT_ALIGN - length % DIRECT_ALIGN;
+        }
+        if (length > DIRECT_STAGE) {
+            length = DIRECT_STAGE;
+        }
+        ssize_t got = pread(fd, file->stage, length, pageOffset);
+        countIo(fd, pageOffset, got > 0 ? got : 0, false);
+        countSyscall();
+        if (got <= from - pageOffset) {
+            break;
+        }
+        size_t copied = got - (from - pageOffset);
+        if (copied > bytes - done) {
+            copied = bytes - done;
+        }
+        memcpy(to + done, file->stage + (from - pageOffset), copied);
+        done += copied;
+    }
+    return done;
+}
+
+ssize_t directRead(int fd, void *data, size_t bytes) {
+    directFile *file = directFiles[fd];
+    ssize_t got = directPread(fd, data, bytes, file->position);
+    file->position += got;
+    return got;
+}
+
+bool directAppend(char *filename, const void *data, size_t bytes) {
+    int fd = openFile(filename, O_WRONLY | O_CREAT | O_APPEND);
+    if (!isDirect(fd)) {
+        close(fd);
+        return false;
+    }
+    directWrite(fd, data, bytes);
+    closeFile(fd);
+    return true;
+}
@@ -0,0 +1,63 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef DIRECTIO_H
+#define	DIRECTIO_H
+
+#include <sys/types.h>
+
+// alignment required for the file offsets, sizes and memory used with O_DIRECT
+#define DIRECT_ALIGN 4096
+// size of the aligned bounce buffer of each file opened with O_DIRECT.
+// blocks are not a multiple of DIRECT_ALIGN, so they are always copied through it
+#define DIRECT_STAGE (16 * DIRECT_ALIGN)
+
+// when enabled, temp and output files are opened with O_DIRECT so that they
+// bypass the page cache. disabled by default
+void setDirectIO(bool enabled);
+
+bool directIOEnabled();
+
+// opens a temp or output file, with the same flags as open. if direct io is
+// enabled and the file system supports it, the file is opened with O_DIRECT.
+// files opened for writing must only be appended to
+int openFile(char *filename, int flags);
+
+// closes a file opened with openFile. if it was written with O_DIRECT, the
+// last partial page is written padded and the file is truncated to its size
+void closeFile(int fd);
+
+// true if fd was opened with O_DIRECT by openFile
+bool isDirect(int fd);
+
+// the equivalents of write, read and pread for files opened with O_DIRECT.
+// data may have any size and alignment
+ssize_t directWrite(int fd, const void *data, size_t bytes);
+
+ssize_t directRead(int fd, void *data, size_t bytes);
+
+ssize_t directPread(int fd, void *data, size_t bytes, off_t offset);
+
+// opens filename, appends data to it and closes it, using O_DIRECT.
+// returns false if the file system does not support it
+bool directAppend(char *filename, const void *data, size_t bytes);
+
+#endif
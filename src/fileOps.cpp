@@ -26,69 +26,247 @@
 #include <stdio.h>
 #include <fcntl.h> 
 #include <unistd.h>
-#include <time.h>
+#include <math.h>
+#include <pthread.h>
 
-// generates random string
+#include "bufferOps.h"
 
-char* getRandomString() {
-    char* str;
-    str = (char*) malloc(STR_LENGTH);
+// number of blocks a thread generates before writing them at once
+#define GEN_CHUNK_BLOCKS 64
+// the most threads used to generate a file
+#define MAX_GEN_THREADS 16
 
-    const char text[] = "abcdefghijklmnopqrstuvwxyz";
+// the random numbers of a record are drawn from a splitmix64 stream seeded from
+// the seed of the file and the position of the record, so that the record is
+// the same whichever thread generates it
 
-    int i;
-    int len = rand() % (STR_LENGTH - 1);
-    len += 1;
-    for (i = 0; i < len; ++i) {
-        str[i] = text[rand() % (sizeof (text) - 1)];
+inline uint64_t nextRandom(uint64_t &state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// returns a uniform value in [0, 1)
+
+inline double nextUniform(uint64_t &state) {
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// returns a uniform value in [0, n)
+
+inline uint nextBelow(uint64_t &state, uint n) {
+    return (uint) (((nextRandom(state) >> 32) * n) >> 32);
+}
+
+// a file being generated
+
+typedef struct {
+    const genSpec *spec;
+    int fd;
+    uint size;
+    // number of records of the file
+    uint64_t records;
+    // the cumulative probabilities of the values of GEN_ZIPF, or NULL
+    double *zipfCdf;
+    uint nthreads;
+} genJob;
+
+// the part of a job done by one thread: the chunks first, first + nthreads, ...
+
+typedef struct {
+    genJob *job;
+    uint first;
+} genThread;
+
+// returns the cumulative probabilities of the distinct values of a zipfian
+// distribution with exponent skew
+
+double *zipfTable(uint distinct, double skew) {
+    double *cdf = (double*) malloc(distinct * sizeof (double));
+    double sum = 0;
+    for (uint k = 0; k < distinct; k++) {
+        sum += 1 / pow(k + 1, skew);
+        cdf[k] = sum;
+    }
+    for (uint k = 0; k < distinct; k++) {
+        cdf[k] /= sum;
     }
-    str[i] = '\0';
-    return str;
+    return cdf;
 }
 
-// generates random file
+// fills str with a random string of lowercase letters, zero padded
 
-void create(char *filename, uint size) {
-    int outfile = creat(filename, S_IRWXU);
+inline void randomString(uint64_t &state, char *str) {
+    uint len = 1 + nextBelow(state, STR_LENGTH - 1);
+    uint i = 0;
+    while (i < len) {
+        // a random number holds 13 letters
+        uint64_t letters = nextRandom(state);
+        for (uint j = 0; j < 13 && i < len; j++, i++) {
+            str[i] = 'a' + letters % 26;
+            letters /= 26;
+        }
+    }
+    memset(str + len, 0, STR_LENGTH - len);
+}
 
-    uint recid = 0;
-    record_t record;
-    block_t block;
-    for (uint b = 0; b < size; ++b) { // for each block
-        block.blockid = b;
-        for (int r = 0; r < MAX_RECORDS_PER_BLOCK; ++r) { // for each record
-
-            // prepare a record
-            record.recid = recid += 1;
-            record.num = rand() % 100000;
-            strcpy(record.str, getRandomString()); // put a random string to record
-            if (((double) rand() / (RAND_MAX)) >= 0.02) {
-                record.valid = true;
-            } else {
-                record.valid = false;
+// writes num to str zero padded to 10 digits, so that the strings are ordered
+// like the numbers
+
+inline void numberString(uint num, char *str) {
+    for (int i = 9; i >= 0; i--) {
+        str[i] = '0' + num % 10;
+        num /= 10;
+    }
+    memset(str + 10, 0, STR_LENGTH - 10);
+}
+
+// generates the record at position pos of the file
+
+inline void generateRecord(const genJob &job, uint64_t pos, record_t &record) {
+    const genSpec &spec = *job.spec;
+    uint64_t state = spec.seed * 0xD1B54A32D192ED03ULL ^ pos;
+    record.recid = pos + 1;
+    record.valid = nextUniform(state) >= 0.02;
+    switch (spec.distribution) {
+        case GEN_UNIFORM:
+            record.num = nextBelow(state, spec.distinct);
+            randomString(state, record.str);
+            return;
+        case GEN_ZIPF:
+        {
+            // finds the first value whose cumulative probability is higher
+            double u = nextUniform(state);
+            uint lower = 0, upper = spec.distinct - 1;
+            while (lower < upper) {
+                uint middle = lower + (upper - lower) / 2;
+                if (job.zipfCdf[middle] > u) {
+                    upper = middle;
+                } else {
+                    lower = middle + 1;
+                }
             }
-            memcpy(&block.entries[r], &record, sizeof (record_t)); // copy record to block
+            record.num = lower;
+            break;
         }
-        block.nreserved = MAX_RECORDS_PER_BLOCK;
-        block.valid = true;
-        write(outfile, &block, sizeof (block_t));
+        case GEN_SORTED:
+            record.num = pos * spec.distinct / job.records;
+            break;
+        case GEN_REVERSE_SORTED:
+            record.num = (job.records - 1 - pos) * spec.distinct / job.records;
+            break;
+        case GEN_DUPLICATES:
+            record.num = nextBelow(state, spec.distinct);
+            break;
+        case GEN_UNIQUE:
+            // 2654435761 is a prime, so multiplying by it permutes the positions
+            record.num = pos * 2654435761ULL % job.records;
+            break;
+        default:
+            record.num = nextBelow(state, spec.distinct);
+            if (nextUniform(state) >= spec.selectivity) {
+                record.num += spec.distinct;
+            }
+    }
+    numberString(record.num, record.str);
+}
+
+// generates the chunks of a thread and writes each one with a single pwrite
+
+void *generateChunks(void *arg) {
+    genThread &thread = *(genThread*) arg;
+    genJob &job = *thread.job;
+    // calloc leaves the padding of the records zeroed, so the same spec
+    // generates the same bytes
+    block_t *chunk = (block_t*) calloc(GEN_CHUNK_BLOCKS, sizeof (block_t));
+    for (uint first = thread.first * GEN_CHUNK_BLOCKS; first < job.size; first += job.nthreads * GEN_CHUNK_BLOCKS) {
+        uint blocks = job.size - first;
+        if (blocks > GEN_CHUNK_BLOCKS) {
+            blocks = GEN_CHUNK_BLOCKS;
+        }
+        for (uint b = 0; b < blocks; b++) {
+            block_t &block = chunk[b];
+            block.blockid = first + b;
+            block.nreserved = MAX_RECORDS_PER_BLOCK;
+            block.valid = true;
+            for (uint r = 0; r < MAX_RECORDS_PER_BLOCK; r++) {
+                generateRecord(job, (uint64_t) (first + b) * MAX_RECORDS_PER_BLOCK + r, block.entries[r]);
+            }
+        }
+        pwrite(job.fd, chunk, blocks * sizeof (block_t), (off_t) first * sizeof (block_t));
     }
-    close(outfile);
+    free(chunk);
+    return NULL;
+}
+
+genSpec defaultSpec(keyDistribution distribution, uint64_t seed) {
+    genSpec spec;
+    spec.distribution = distribution;
+    spec.seed = seed;
+    spec.distinct = 100000;
+    spec.skew = 1;
+    spec.selectivity = 1;
+    return spec;
+}
+
+void generateFile(char *filename, uint size, const genSpec &spec) {
+    genJob job;
+    job.spec = &spec;
+    job.fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU);
+    job.size = size;
+    job.records = (uint64_t) size * MAX_RECORDS_PER_BLOCK;
+    job.zipfCdf = spec.distribution == GEN_ZIPF ? zipfTable(spec.distinct, spec.skew) : NULL;
+
+    uint chunks = (size + GEN_CHUNK_BLOCKS - 1) / GEN_CHUNK_BLOCKS;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    job.nthreads = cpus > 0 ? cpus : 1;
+    if (job.nthreads > MAX_GEN_THREADS) {
+        job.nthreads = MAX_GEN_THREADS;
+    }
+    if (job.nthreads > chunks) {
+        job.nthreads = chunks != 0 ? chunks : 1;
+    }
+
+    genThread threads[MAX_GEN_THREADS];
+    pthread_t ids[MAX_GEN_THREADS];
+    for (uint t = 0; t < job.nthreads; t++) {
+        threads[t].job = &job;
+        threads[t].first = t;
+    }
+    // the first part is generated by the calling thread
+    for (uint t = 1; t < job.nthreads; t++) {
+        pthread_create(&ids[t], NULL, generateChunks, &threads[t]);
+    }
+    generateChunks(&threads[0]);
+    for (uint t = 1; t < job.nthreads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    close(job.fd);
+    free(job.zipfCdf);
+}
+
+void generateJoinFiles(char *filename1, uint size1, char *filename2, uint size2, double selectivity, uint64_t seed) {
+    genSpec spec1 = defaultSpec(GEN_UNIQUE, seed);
+    generateFile(filename1, size1, spec1);
+    // the values of filename1 are the positions of its records
+    genSpec spec2 = defaultSpec(GEN_MATCHING, seed + 1);
+    spec2.distinct = size1 * MAX_RECORDS_PER_BLOCK;
+    spec2.selectivity = selectivity;
+    generateFile(filename2, size2, spec2);
 }
 
 // creates one input file
 
 void createFile(char *filename, uint size) {
-    srand(time(NULL));
-    create(filename, size);
+    generateFile(filename, size, defaultSpec(GEN_UNIFORM, 1));
 }
 
 // creates two input files
 
 void createTwoFiles(char *filename1, uint size1, char *filename2, uint size2) {
-    srand(time(NULL));
-    create(filename1, size1);
-    create(filename2, size2);
+    generateFile(filename1, size1, defaultSpec(GEN_UNIFORM, 1));
+    generateFile(filename2, size2, defaultSpec(GEN_UNIFORM, 2));
 }
 
 // prints file
@@ -99,11 +277,9 @@ void printFile(char *filename) {
 
     block_t block;
     while (read(infile, &block, sizeof (block_t)) > 0) {
-        for (uint i = 0; i < block.nreserved; ++i) {
-            if (block.entries[i].valid) {
-                printf("BL %d, RC %d, %d, %s\n", block.blockid, block.entries[i].recid, block.entries[i].num, block.entries[i].str);
-            }
-
+        recordMask valid = validRecords(&block);
+        for (int i = nextValid(valid); i >= 0 && i < (int) block.nreserved; i = nextValid(valid)) {
+            printf("BL %d, RC %d, %d, %s\n", block.blockid, block.entries[i].recid, block.entries[i].num, block.entries[i].str);
         }
     }
     close(infile);
@@ -25,10 +25,69 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <stdint.h>
+
 #include "dbtproj.h"
 
+// distributions of the values of num of a generated file. 2% of the records
+// are invalid and recid is the position of the record, counted from 1
+// GEN_UNIFORM: num is uniform over distinct values and str is random
+// GEN_ZIPF: num is zipfian over distinct values, value 0 the most frequent, so
+// that the value of rank k appears with probability proportional to 1/k^skew
+// GEN_SORTED: num grows with recid, spread over distinct values
+// GEN_REVERSE_SORTED: num falls as recid grows, spread over distinct values
+// GEN_DUPLICATES: num is uniform over distinct values, which should be few, so
+// each value appears many times
+// GEN_UNIQUE: num is a permutation of the positions of the records, so each
+// value appears once. distinct is not used
+// GEN_MATCHING: with probability selectivity num is uniform over distinct
+// values, otherwise over the distinct values that follow them. used for the
+// second file of generateJoinFiles
+// for all but GEN_UNIFORM, str is num zero padded, so it is ordered and
+// repeated like num
+
+enum keyDistribution {
+    GEN_UNIFORM,
+    GEN_ZIPF,
+    GEN_SORTED,
+    GEN_REVERSE_SORTED,
+    GEN_DUPLICATES,
+    GEN_UNIQUE,
+    GEN_MATCHING
+};
+
+// what a generated file holds. the same spec always generates the same file,
+// whatever the number of threads used
+
+typedef struct {
+    keyDistribution distribution;
+    uint64_t seed;
+    // number of distinct values of num, at least 1
+    uint distinct;
+    // exponent of GEN_ZIPF
+    double skew;
+    // probability that a record of GEN_MATCHING has a value below distinct
+    double selectivity;
+} genSpec;
+
+// returns a spec with distinct = 100000 (the range of createFile), skew = 1 and
+// selectivity = 1
+genSpec defaultSpec(keyDistribution distribution, uint64_t seed);
+
+// generates a file of size blocks following spec. the blocks are generated by
+// as many threads as there are cpus, and written in large chunks
+void generateFile(char *filename, uint size, const genSpec &spec);
+
+// generates two files to be joined. the values of num of filename1 are unique
+// (GEN_UNIQUE) and a record of filename2 matches one of them with probability
+// selectivity, otherwise none
+void generateJoinFiles(char *filename1, uint size1, char *filename2, uint size2, double selectivity, uint64_t seed);
+
+// creates a file with uniform values, like generateFile with GEN_UNIFORM and a
+// fixed seed
 void createFile(char *filename, uint size);
 
+// creates two files with uniform values and different seeds
 void createTwoFiles(char *filename1, uint size1, char *filename2, uint size2);
 
 void printFile(char *filename);
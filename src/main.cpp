@@ -25,6 +25,14 @@
 
 #include "dbtproj.h"
 #include "fileOps.h"
+#include "blockScan.h"
+#include "directIO.h"
+#include "blockBatch.h"
+#include "bufferPool.h"
+#include "blockCodec.h"
+#include "strKernels.h"
+#include "opStats.h"
+#include "tempSpace.h"
 
 int main(int argc, char** argv) {
 
@@ -38,12 +46,32 @@ int main(int argc, char** argv) {
     //printFile(infile1);
     //printFile(infile2);
 
+    // sequential scans read blocks through mmap instead of read
+    //setScanBackend(SCAN_MMAP, SCAN_POPULATE);
+    // temp and output files bypass the page cache
+    //setDirectIO(true);
+    // batches of block ios are submitted through io_uring
+    //setBatchBackend(BATCH_URING);
+    // the sorted segments of intermediate passes are compressed
+    //setTempCompression(true);
+    // str is compared and hashed without vector instructions, whatever the cpu
+    //setStrKernel(STR_SCALAR);
+    // temp files are kept under /tmp, or spread over the directories listed
+    //setTempDirs("/tmp");
+
     uint nmem_blocks = 22;
     block_t* buffer = (block_t*) malloc(nmem_blocks * sizeof (block_t));
     uint nsorted_segs = 0, npasses = 0, nios = 0, nres = 0, nunique = 0;
 
+    // the time, ios and comparisons of each phase of MergeSort are collected
+    // and printed as JSON
+    opStats stats;
+    startStats(stats);
     MergeSort(infile1, 1, buffer, nmem_blocks, outfile, &nsorted_segs, &npasses, &nios);
+    stopStats();
     printf("nios = %d, npasses = %d, nsorted_segs = %d\n", nios, npasses, nsorted_segs);
+    writeStatsJson(stats, stdout);
+    destroyStats(stats);
     //printFile(outfile);
 
     HashJoin(infile1, infile2, 2, buffer, nmem_blocks, outfile, &nres, &nios);
@@ -55,7 +83,9 @@ int main(int argc, char** argv) {
     //printFile(outfile);
 
     MergeJoin(infile1, infile2, 0, buffer, nmem_blocks, outfile, &nres, &nios);
-    printf("nios = %d, nres = %d\n", nios, nres);
+    uint hits, misses;
+    poolStats(&hits, &misses);
+    printf("nios = %d, nres = %d, pool hits = %d, pool misses = %d\n", nios, nres, hits, misses);
     //printFile(outfile);
 
     return 0;
@@ -0,0 +1,185 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include "opStats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// files with a descriptor higher than this have all their positioned ios
+// counted as random
+#define MAX_STATS_FILES 1024
+
+thread_local statsCounters threadCounters;
+
+// for each file, the offset where its last positioned io ended plus one, or 0
+// if it has done none since it was opened. then an io at offset 0 is sequential
+static thread_local off_t lastEnd[MAX_STATS_FILES];
+
+// the stats collected, the phase that is not ended (-1 if there is none) and
+// the times and counters at the start of the collection and of the phase
+static thread_local opStats *collected = NULL;
+static thread_local int openPhase = -1;
+static thread_local double startWall, startCpu, phaseWall, phaseCpu;
+static thread_local statsCounters startCounters, phaseCounters;
+
+inline double readClock(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// adds the change of the counters since from to to
+
+void addCounters(statsCounters &to, const statsCounters &from) {
+    to.bytesRead += threadCounters.bytesRead - from.bytesRead;
+    to.bytesWritten += threadCounters.bytesWritten - from.bytesWritten;
+    to.sequentialReads += threadCounters.sequentialReads - from.sequentialReads;
+    to.randomReads += threadCounters.randomReads - from.randomReads;
+    to.sequentialWrites += threadCounters.sequentialWrites - from.sequentialWrites;
+    to.randomWrites += threadCounters.randomWrites - from.randomWrites;
+    to.syscalls += threadCounters.syscalls - from.syscalls;
+    to.comparisons += threadCounters.comparisons - from.comparisons;
+}
+
+void countIo(int fd, off_t offset, size_t bytes, bool written) {
+    bool sequential = true;
+    if (offset >= 0) {
+        if (fd >= 0 && fd < MAX_STATS_FILES) {
+            sequential = lastEnd[fd] == offset + 1 || (lastEnd[fd] == 0 && offset == 0);
+            lastEnd[fd] = offset + bytes + 1;
+        } else {
+            sequential = false;
+        }
+    }
+    if (written) {
+        threadCounters.bytesWritten += bytes;
+        if (sequential) {
+            threadCounters.sequentialWrites += 1;
+        } else {
+            threadCounters.randomWrites += 1;
+        }
+    } else {
+        threadCounters.bytesRead += bytes;
+        if (sequential) {
+            threadCounters.sequentialReads += 1;
+        } else {
+            threadCounters.randomReads += 1;
+        }
+    }
+}
+
+void forgetFile(int fd) {
+    if (fd >= 0 && fd < MAX_STATS_FILES) {
+        lastEnd[fd] = 0;
+    }
+}
+
+void startStats(opStats &stats) {
+    memset(&stats, 0, sizeof (opStats));
+    collected = &stats;
+    openPhase = -1;
+    startWall = readClock(CLOCK_MONOTONIC);
+    startCpu = readClock(CLOCK_THREAD_CPUTIME_ID);
+    startCounters = threadCounters;
+}
+
+void stopStats() {
+    if (!collected) {
+        return;
+    }
+    endPhase();
+    (*collected).wallSeconds = readClock(CLOCK_MONOTONIC) - startWall;
+    (*collected).cpuSeconds = readClock(CLOCK_THREAD_CPUTIME_ID) - startCpu;
+    addCounters((*collected).counters, startCounters);
+    collected = NULL;
+}
+
+void destroyStats(opStats &stats) {
+    free(stats.phases);
+    stats.phases = NULL;
+    stats.nphases = 0;
+    stats.capacity = 0;
+}
+
+void beginPhase(const char *name, uint pass) {
+    if (!collected) {
+        return;
+    }
+    endPhase();
+    opStats &stats = *collected;
+    // the phase is added to the one with the same name and pass, if it exists
+    uint i = 0;
+    while (i < stats.nphases && (stats.phases[i].pass != pass || strcmp(stats.phases[i].name, name) != 0)) {
+        i++;
+    }
+    if (i == stats.nphases) {
+        if (stats.nphases == stats.capacity) {
+            stats.capacity = stats.capacity == 0 ? 8 : 2 * stats.capacity;
+            stats.phases = (phaseStats*) realloc(stats.phases, stats.capacity * sizeof (phaseStats));
+        }
+        memset(stats.phases + i, 0, sizeof (phaseStats));
+        stats.phases[i].name = name;
+        stats.phases[i].pass = pass;
+        stats.nphases += 1;
+    }
+    stats.phases[i].count += 1;
+    openPhase = i;
+    phaseWall = readClock(CLOCK_MONOTONIC);
+    phaseCpu = readClock(CLOCK_THREAD_CPUTIME_ID);
+    phaseCounters = threadCounters;
+}
+
+void endPhase() {
+    if (!collected || openPhase < 0) {
+        return;
+    }
+    phaseStats &phase = (*collected).phases[openPhase];
+    phase.wallSeconds += readClock(CLOCK_MONOTONIC) - phaseWall;
+    phase.cpuSeconds += readClock(CLOCK_THREAD_CPUTIME_ID) - phaseCpu;
+    addCounters(phase.counters, phaseCounters);
+    openPhase = -1;
+}
+
+// writes the times and counters of a phase or of the totals, as members of a
+// JSON object
+
+void writeCountersJson(double wallSeconds, double cpuSeconds, const statsCounters &counters, FILE *out) {
+    fprintf(out, "\"wall_seconds\": %.6f, \"cpu_seconds\": %.6f, ", wallSeconds, cpuSeconds);
+    fprintf(out, "\"bytes_read\": %llu, \"bytes_written\": %llu, ", (unsigned long long) counters.bytesRead, (unsigned long long) counters.bytesWritten);
+    fprintf(out, "\"sequential_reads\": %llu, \"random_reads\": %llu, ", (unsigned long long) counters.sequentialReads, (unsigned long long) counters.randomReads);
+    fprintf(out, "\"sequential_writes\": %llu, \"random_writes\": %llu, ", (unsigned long long) counters.sequentialWrites, (unsigned long long) counters.randomWrites);
+    fprintf(out, "\"syscalls\": %llu, \"comparisons\": %llu", (unsigned long long) counters.syscalls, (unsigned long long) counters.comparisons);
+}
+
+void writeStatsJson(const opStats &stats, FILE *out) {
+    fprintf(out, "{");
+    writeCountersJson(stats.wallSeconds, stats.cpuSeconds, stats.counters, out);
+    fprintf(out, ", \"phases\": [");
+    for (uint i = 0; i < stats.nphases; i++) {
+        const phaseStats &phase = stats.phases[i];
+        fprintf(out, "%s\n  {\"name\": \"%s\", \"pass\": %u, \"count\": %u, ", i == 0 ? "" : ",", phase.name, phase.pass, phase.count);
+        writeCountersJson(phase.wallSeconds, phase.cpuSeconds, phase.counters, out);
+        fprintf(out, "}");
+    }
+    fprintf(out, "]}\n");
+}
@@ -0,0 +1,119 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef OPSTATS_H
+#define	OPSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// counters of the work done by the calling thread. they only grow, and the
+// stats of a phase are their change from its start to its end.
+// the ios are the reads and writes of the io layer: a positioned io is
+// sequential if it starts where the previous positioned io of its file ended,
+// the ios at the current position of a file (read, write, appends) are always
+// sequential. syscalls are the reads, writes, io_uring submissions, seeks and
+// mappings of the io layer; open and close are not counted. comparisons are the
+// comparisons of records done through the key policies
+
+typedef struct {
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    uint64_t sequentialReads;
+    uint64_t randomReads;
+    uint64_t sequentialWrites;
+    uint64_t randomWrites;
+    uint64_t syscalls;
+    uint64_t comparisons;
+} statsCounters;
+
+extern thread_local statsCounters threadCounters;
+
+// the stats of a phase of an operator. the work of all the phases with the same
+// name and pass is added up, count is how many times the phase was begun
+
+typedef struct {
+    const char *name;
+    // the pass of the operator, counted from 1 like npasses, or 0 if the phase
+    // is not a pass
+    uint pass;
+    uint count;
+    double wallSeconds;
+    double cpuSeconds;
+    statsCounters counters;
+} phaseStats;
+
+// the stats of the operators run while it was collected. the phases are kept
+// in the order they were first begun, and the totals include the work done
+// outside of any phase
+
+typedef struct {
+    phaseStats *phases;
+    uint nphases;
+    uint capacity;
+    double wallSeconds;
+    double cpuSeconds;
+    statsCounters counters;
+} opStats;
+
+// starts collecting the stats of the operators run by the calling thread into
+// stats, which is emptied first. only one opStats is collected at a time
+void startStats(opStats &stats);
+
+// ends the phase begun last and stops collecting. the totals of stats are set
+void stopStats();
+
+// frees the memory allocated for stats
+void destroyStats(opStats &stats);
+
+// ends the phase begun last, if it is not ended, and begins a new one. name
+// must stay allocated while the stats are used. nothing is done if no stats
+// are collected
+void beginPhase(const char *name, uint pass);
+
+// ends the phase begun last, if it is not ended
+void endPhase();
+
+// writes stats to out as a JSON object
+void writeStatsJson(const opStats &stats, FILE *out);
+
+// adds an io of bytes at offset of the file described by fd to the counters.
+// offset is -1 for ios done at the current position of the file. the syscall
+// that did it is counted separately
+void countIo(int fd, off_t offset, size_t bytes, bool written);
+
+// forgets where the last io of the file described by fd ended. it is called
+// when the file is closed, so that the next file given the same descriptor
+// is not classified against it
+void forgetFile(int fd);
+
+inline void countSyscall() {
+    threadCounters.syscalls += 1;
+}
+
+inline void countComparison() {
+    threadCounters.comparisons += 1;
+}
+
+#endif
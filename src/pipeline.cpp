@@ -0,0 +1,108 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+
+#include "dbtproj.h"
+#include "directIO.h"
+#include "pipeline.h"
+#include "blockSink.h"
+
+blockIterator *newIterator(block_t *(*next)(blockIterator*, uint*), void (*close)(blockIterator*), void *state) {
+    blockIterator *it = (blockIterator*) malloc(sizeof (blockIterator));
+    (*it).next = next;
+    (*it).close = close;
+    (*it).state = state;
+    return it;
+}
+
+void closeIterator(blockIterator *it) {
+    (*it).close(it);
+    free(it);
+}
+
+uint drainIterator(blockIterator *it, blockSink *sink, uint *nios) {
+    uint blocksPassed = 0;
+    block_t *block;
+    while ((block = pullBlock(it, nios))) {
+        (*block).blockid = blocksPassed;
+        (*block).valid = true;
+        (*nios) += putBlock(sink, block);
+        blocksPassed += 1;
+    }
+    closeIterator(it);
+    return blocksPassed;
+}
+
+uint writeIterator(blockIterator *it, char *outfile, uint *nios) {
+    int out = openFile(outfile, O_WRONLY | O_CREAT | O_TRUNC);
+    blockSink sink = fileSink(out);
+    uint blocksWritten = drainIterator(it, &sink, nios);
+    closeFile(out);
+    return blocksWritten;
+}
+
+void SortDedupJoin(char *infile1, char *infile2, unsigned char field, block_t *buffer, unsigned int nmem_blocks, char *outfile, unsigned int *nres, unsigned int *nios) {
+
+    if (nmem_blocks < 9) {
+        printf("At least 9 blocks are required.");
+        return;
+    }
+
+    *nres = 0;
+    *nios = 0;
+
+    // the buffer is split as follows: the blocks of the last merge of each
+    // sort, one output block for each dedup, 2 blocks for the groups of the
+    // join and one output block for the join. both sorts use the whole buffer
+    // until their last merges, which are only started when the join pulls
+    // its first block
+    uint mergeBlocks1 = (nmem_blocks - 5) / 2;
+    uint mergeBlocks2 = nmem_blocks - 5 - mergeBlocks1;
+    block_t *mergeBuffer1 = buffer;
+    block_t *mergeBuffer2 = mergeBuffer1 + mergeBlocks1;
+    block_t *dedupOut1 = mergeBuffer2 + mergeBlocks2;
+    block_t *dedupOut2 = dedupOut1 + 1;
+    block_t *groupBuffer = dedupOut2 + 1;
+    block_t *joinOut = groupBuffer + 2;
+
+    uint nunique1 = 0, nunique2 = 0;
+    blockIterator *sort1 = openSort(infile1, field, buffer, nmem_blocks, mergeBuffer1, mergeBlocks1, nios);
+    if (sort1 == NULL) {
+        return;
+    }
+    blockIterator *sort2 = openSort(infile2, field, buffer, nmem_blocks, mergeBuffer2, mergeBlocks2, nios);
+    if (sort2 == NULL) {
+        closeIterator(sort1);
+        return;
+    }
+    blockIterator *dedup1 = openDedup(sort1, field, dedupOut1, &nunique1);
+    blockIterator *dedup2 = openDedup(sort2, field, dedupOut2, &nunique2);
+    blockIterator *join = openMergeJoin(dedup1, dedup2, field, groupBuffer, 2, joinOut, nres);
+    if (join == NULL) {
+        closeIterator(dedup1);
+        closeIterator(dedup2);
+        return;
+    }
+    writeIterator(join, outfile, nios);
+}
@@ -0,0 +1,118 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef PIPELINE_H
+#define	PIPELINE_H
+
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// an operator of a pipeline. operators pass their output to the next one block
+// by block, in memory, instead of writing it to a file.
+// next returns the next output block, or NULL when the output is over (and
+// from then on). the block returned holds its records in its first nreserved
+// entries and stays unchanged until the following call. the ios done are
+// added to nios.
+// close frees the state of the operator and of its inputs, and removes its
+// temp files
+
+typedef struct blockIterator {
+    block_t *(*next)(blockIterator *it, uint *nios);
+    void (*close)(blockIterator *it);
+    void *state;
+} blockIterator;
+
+// returns a new iterator with the given functions and state
+
+blockIterator *newIterator(block_t *(*next)(blockIterator*, uint*), void (*close)(blockIterator*), void *state);
+
+// returns the next block of it, or NULL if it is over
+
+inline block_t *pullBlock(blockIterator *it, uint *nios) {
+    return (*it).next(it, nios);
+}
+
+// returns the record at position pos of block, pulling the next block of input
+// when block is over (block is NULL before the first one is pulled). returns
+// NULL when input is over
+
+inline const record_t *peekRecord(blockIterator *input, block_t *&block, uint &pos, uint *nios) {
+    while (!block || pos == (*block).nreserved) {
+        block = pullBlock(input, nios);
+        pos = 0;
+        if (!block) {
+            return NULL;
+        }
+    }
+    return (*block).entries + pos;
+}
+
+// closes it and its inputs and frees it
+void closeIterator(blockIterator *it);
+
+struct blockSink;
+
+// passes the output of it to sink, then closes it. returns the number of
+// blocks passed
+uint drainIterator(blockIterator *it, blockSink *sink, uint *nios);
+
+// writes the output of it to outfile, then closes it. returns the number of
+// blocks written
+uint writeIterator(blockIterator *it, char *outfile, uint *nios);
+
+/*
+ * infile: the file to be sorted
+ * field: which field will be used for sorting
+ * buffer, nmem_blocks: the buffer used to sort infile down to the segments of the last merge.
+ * it is only used until openSort returns
+ * mergeBuffer, mergeBlocks: the blocks used by the last merge, one for each segment and
+ * one for output. at least 2 are required
+ * nios: number of ios
+ *
+ * the output is infile sorted. the last merge is done as the output is pulled.
+ * returns NULL if the temp workspace of the sort can not be created
+ */
+blockIterator *openSort(char *infile, unsigned char field, block_t *buffer, uint nmem_blocks, block_t *mergeBuffer, uint mergeBlocks, uint *nios);
+
+/*
+ * input: an iterator whose output is sorted on field
+ * bufferOut: the block used for output
+ * nunique: number of unique records, increased as the output is pulled
+ *
+ * the output is input with each value of field once
+ */
+blockIterator *openDedup(blockIterator *input, unsigned char field, block_t *bufferOut, uint *nunique);
+
+/*
+ * left, right: iterators whose outputs are sorted on field
+ * groupBuffer, groupBlocks: the blocks that hold a group of records of left with equal
+ * values. the last one is used to spill larger groups to a temp file. at least 2 are required
+ * bufferOut: the block used for output
+ * nres: number of pairs, increased as the output is pulled
+ *
+ * the output is the pairs of records of left and right with equal values of
+ * field, the record of left first. returns NULL if the temp workspace of the
+ * join can not be created, in which case left and right are left open
+ */
+blockIterator *openMergeJoin(blockIterator *left, blockIterator *right, unsigned char field, block_t *groupBuffer, uint groupBlocks, block_t *bufferOut, uint *nres);
+
+#endif
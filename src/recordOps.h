@@ -23,19 +23,24 @@
 #define	RECORDOPS_H
 
 #include <string.h>
+#include <limits.h>
 
 #include "dbtproj.h"
 #include "recordPtr.h"
+#include "strKernels.h"
+#include "opStats.h"
 
-// given a buffer and a recordPtr, returns corresponding record
+// given a buffer and a recordPtr, returns a read-only view of the corresponding
+// record. it is not copied, so callers that keep it while the buffer changes
+// must copy it themselves
 
-inline record_t getRecord(block_t *buffer, recordPtr ptr) {
+inline const record_t &getRecord(block_t *buffer, recordPtr ptr) {
     return buffer[ptr.block].entries[ptr.record];
 }
 
 // given a buffer, a record and a recordPtr, places the record where recordPtr points
 
-inline void setRecord(block_t *buffer, record_t rec, recordPtr ptr) {
+inline void setRecord(block_t *buffer, const record_t &rec, recordPtr ptr) {
     buffer[ptr.block].entries[ptr.record] = rec;
 }
 
@@ -47,42 +52,17 @@ inline void swapRecords(block_t *buffer, recordPtr ptr1, recordPtr ptr2) {
     setRecord(buffer, tmp, ptr2);
 }
 
-// given 2 records and field, compares them
-// -1 is returned if rec1 has lower field value than rec2
-// 0 is returned if rec1 and rec2 have equal field values
-// 1 is returned if rec1 has higher field value than rec2
+// the partner of a record with no pair in the output of an outer join. it is
+// valid, so that the pairs stay aligned in the output blocks, its recid and num
+// are UINT_MAX and its str is empty
 
-inline int compareRecords(record_t rec1, record_t rec2, unsigned char field) {
-    switch (field) {
-        case 0:
-            if (rec1.recid < rec2.recid) {
-                return -1;
-            } else if (rec1.recid > rec2.recid) {
-                return 1;
-            }
-            return 0;
-        case 1:
-            if (rec1.num < rec2.num) {
-                return -1;
-            } else if (rec1.num > rec2.num) {
-                return 1;
-            }
-            return 0;
-        case 2:
-            if (strcmp(rec1.str, rec2.str) < 0) {
-                return -1;
-            } else if (strcmp(rec1.str, rec2.str) > 0) {
-                return 1;
-            }
-            return 0;
-        case 3:
-            if ((rec1.num < rec2.num || (rec1.num == rec2.num && strcmp(rec1.str, rec2.str) < 0))) {
-                return -1;
-            } else if ((rec1.num > rec2.num || (rec1.num == rec2.num && strcmp(rec1.str, rec2.str) > 0))) {
-                return 1;
-            }
-            return 0;
-    }
+inline const record_t &nullRecord() {
+    static record_t null = {UINT_MAX, UINT_MAX, "", true};
+    return null;
+}
+
+inline bool isNullRecord(const record_t &rec) {
+    return rec.recid == UINT_MAX && rec.num == UINT_MAX && rec.str[0] == '\0';
 }
 
 // hash function for integers
@@ -98,9 +78,10 @@ inline uint hashInt(uint num, uint mod, uint seed) {
     return num % mod;
 }
 
-// hash function for strings
+// hash function for strings of any length, eg filenames.
+// the str field of records is hashed with hashStr instead
 
-inline uint hashString(char *str, uint mod, uint seed) {
+inline uint hashString(const char *str, uint mod, uint seed) {
     unsigned long hash = 5381;
     int c;
 
@@ -111,20 +92,143 @@ inline uint hashString(char *str, uint mod, uint seed) {
     return hashInt(hash, 8701123, seed) % mod;
 }
 
+// given the seed string of a hash function, returns the integer seed that
+// the key policies expect, so that it is computed once and not per record
+
+inline uint hashSeed(const char *seed) {
+    return hashString(seed, 8701123, 0);
+}
+
+// key policies, one per field. each one compares two records in place with
+// a single three-way comparison (<0, 0 or >0, like strcmp) and hashes them
+// on its field. kernels are templated on a key policy so that the field is
+// resolved at compile time, once per operator, instead of per comparison.
+// the comparisons are counted in the stats of the calling thread
+
+struct RecidKey {
+    static const unsigned char field = 0;
+
+    static inline int compare(const record_t &rec1, const record_t &rec2) {
+        countComparison();
+        return (rec1.recid > rec2.recid) - (rec1.recid < rec2.recid);
+    }
+
+    static inline uint hash(uint seed, const record_t &rec, uint mod) {
+        return hashInt(rec.recid, mod, seed);
+    }
+};
+
+struct NumKey {
+    static const unsigned char field = 1;
+
+    static inline int compare(const record_t &rec1, const record_t &rec2) {
+        countComparison();
+        return (rec1.num > rec2.num) - (rec1.num < rec2.num);
+    }
+
+    static inline uint hash(uint seed, const record_t &rec, uint mod) {
+        return hashInt(rec.num, mod, seed);
+    }
+};
+
+struct StrKey {
+    static const unsigned char field = 2;
+
+    static inline int compare(const record_t &rec1, const record_t &rec2) {
+        countComparison();
+        return compareStr(rec1.str, rec2.str);
+    }
+
+    static inline uint hash(uint seed, const record_t &rec, uint mod) {
+        return hashInt(hashStr(rec.str), mod, seed);
+    }
+};
+
+struct NumStrKey {
+    static const unsigned char field = 3;
+
+    static inline int compare(const record_t &rec1, const record_t &rec2) {
+        countComparison();
+        if (rec1.num != rec2.num) {
+            return rec1.num < rec2.num ? -1 : 1;
+        }
+        return compareStr(rec1.str, rec2.str);
+    }
+
+    static inline uint hash(uint seed, const record_t &rec, uint mod) {
+        return hashInt(rec.num + hashStr(rec.str), mod, seed);
+    }
+};
+
+// given 2 records and field, compares them
+// a negative value is returned if rec1 has lower field value than rec2
+// 0 is returned if rec1 and rec2 have equal field values
+// a positive value is returned if rec1 has higher field value than rec2
+// kernels should use the key policies directly, this is for the cold paths
+
+inline int compareRecords(const record_t &rec1, const record_t &rec2, unsigned char field) {
+    switch (field) {
+        case 0:
+            return RecidKey::compare(rec1, rec2);
+        case 1:
+            return NumKey::compare(rec1, rec2);
+        case 2:
+            return StrKey::compare(rec1, rec2);
+        default:
+            return NumStrKey::compare(rec1, rec2);
+    }
+}
+
 // given a record and the field of interest, hashes it and returns a value
 
-inline uint hashRecord(char* seed, record_t rec, uint mod, unsigned char field) {
-    uint s = hashString(seed, 8701123, 0);
+inline uint hashRecord(char* seed, const record_t &rec, uint mod, unsigned char field) {
+    uint s = hashSeed(seed);
     switch (field) {
         case 0:
-            return hashInt(rec.recid, mod, s);
+            return RecidKey::hash(s, rec, mod);
         case 1:
-            return hashInt(rec.num, mod, s);
+            return NumKey::hash(s, rec, mod);
         case 2:
-            return hashString(rec.str, mod, s);
-        case 3:
-            return hashInt(rec.num + hashString(rec.str, mod, s), mod, s);
+            return StrKey::hash(s, rec, mod);
+        default:
+            return NumStrKey::hash(s, rec, mod);
+    }
+}
+
+// given a buffer with records sorted on Key between start and end (inclusive),
+// returns a recordPtr to the first record not lower than rec, or end + 1 if
+// there is none. the distance is first bounded by doubling the step
+// (galloping) and then binary searched, so long runs of lower records cost
+// logarithmic instead of linear comparisons
+
+template <class Key>
+recordPtr gallopSearch(block_t *buffer, recordPtr start, recordPtr end, const record_t &rec) {
+    if (start > end || Key::compare(getRecord(buffer, start), rec) >= 0) {
+        return start;
+    }
+    uint last = getOffset(end);
+    // lower bound is always a record lower than rec, upper bound is
+    // either a record not lower than rec or one past end
+    uint lower = getOffset(start);
+    uint upper = last + 1;
+    uint step = 1;
+    while (lower + step <= last) {
+        if (Key::compare(getRecord(buffer, newPtr(lower + step)), rec) >= 0) {
+            upper = lower + step;
+            break;
+        }
+        lower += step;
+        step *= 2;
+    }
+    while (upper - lower > 1) {
+        uint middle = lower + (upper - lower) / 2;
+        if (Key::compare(getRecord(buffer, newPtr(middle)), rec) >= 0) {
+            upper = middle;
+        } else {
+            lower = middle;
+        }
     }
+    return newPtr(upper);
 }
 
 // frees memory allocated for a hash index
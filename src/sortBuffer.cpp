@@ -25,15 +25,17 @@
 
 #include "recordPtr.h"
 #include "recordOps.h"
+#include "bufferOps.h"
 
 // insertionsort sorting algorithm implementation
 
-void insertionSort(block_t *buffer, recordPtr left, recordPtr right, unsigned char field) {
+template <class Key>
+void insertionSort(block_t *buffer, recordPtr left, recordPtr right) {
     for (recordPtr i = left + 1; i <= right; incr(i)) {
         record_t target = getRecord(buffer, i);
         recordPtr holePos = i;
 
-        while (holePos > left && compareRecords(target, getRecord(buffer, holePos - 1), field) < 0) {
+        while (holePos > left && Key::compare(target, getRecord(buffer, holePos - 1)) < 0) {
             setRecord(buffer, getRecord(buffer, holePos - 1), holePos);
             decr(holePos);
         }
@@ -44,17 +46,18 @@ void insertionSort(block_t *buffer, recordPtr left, recordPtr right, unsigned ch
 
 // after a change in the heap, gives it again heap structure
 
-void siftDown(block_t *buffer, uint offset, recordPtr left, recordPtr right, unsigned char field) {
+template <class Key>
+void siftDown(block_t *buffer, uint offset, recordPtr left, recordPtr right) {
     recordPtr root = copyPtr(left);
 
     while (newPtr((root.block * MAX_RECORDS_PER_BLOCK + root.record) * 2 + 1) <= right) {
         recordPtr child = newPtr((root.block * MAX_RECORDS_PER_BLOCK + root.record) * 2 + 1 + offset);
         recordPtr swap = root + offset;
 
-        if (compareRecords(getRecord(buffer, swap), getRecord(buffer, child), field) < 0) {
+        if (Key::compare(getRecord(buffer, swap), getRecord(buffer, child)) < 0) {
             swap = copyPtr(child);
         }
-        if (child + 1 <= right + offset && compareRecords(getRecord(buffer, swap), getRecord(buffer, child + 1), field) < 0) {
+        if (child + 1 <= right + offset && Key::compare(getRecord(buffer, swap), getRecord(buffer, child + 1)) < 0) {
             swap = child + 1;
         }
         if (swap != root + offset) {
@@ -68,12 +71,13 @@ void siftDown(block_t *buffer, uint offset, recordPtr left, recordPtr right, uns
 
 // reorganises records so that heap structure is achieved
 
-void heapify(block_t *buffer, uint offset, recordPtr right, unsigned char field) {
+template <class Key>
+void heapify(block_t *buffer, uint offset, recordPtr right) {
 
     recordPtr zero = newPtr(0);
     recordPtr start = newPtr(getOffset(right) / 2);
     while (start >= zero) {
-        siftDown(buffer, offset, start, right, field);
+        siftDown<Key>(buffer, offset, start, right);
         if (start == zero) {
             break;
         }
@@ -83,18 +87,19 @@ void heapify(block_t *buffer, uint offset, recordPtr right, unsigned char field)
 
 // heapsort sorting algorithm implementation
 
-void heapSort(block_t *buffer, recordPtr left, recordPtr right, unsigned char field) {
+template <class Key>
+void heapSort(block_t *buffer, recordPtr left, recordPtr right) {
 
     recordPtr zero = newPtr(0);
     uint offset = getOffset(left);
     recordPtr end = right - offset;
 
-    heapify(buffer, offset, end, field);
+    heapify<Key>(buffer, offset, end);
 
     while (end > zero) {
         swapRecords(buffer, end + offset, zero + offset);
         decr(end);
-        siftDown(buffer, offset, zero, end, field);
+        siftDown<Key>(buffer, offset, zero, end);
     }
 }
 
@@ -102,21 +107,22 @@ void heapSort(block_t *buffer, recordPtr left, recordPtr right, unsigned char fi
 // uses quicksort until either the records to be sorted are <=10, where insertion
 // sort is used, or the recursion depth exceeds a limit, where heapsort is used
 
-void introSort(block_t *buffer, recordPtr left, recordPtr right, unsigned char field, uint depth) {
+template <class Key>
+void introSort(block_t *buffer, recordPtr left, recordPtr right, uint depth) {
     if (left < right) {
         if (right - left < 10) {
-            insertionSort(buffer, left, right, field);
+            insertionSort<Key>(buffer, left, right);
         } else if (depth == 0) {
-            heapSort(buffer, left, right, field);
+            heapSort<Key>(buffer, left, right);
         } else {
             record_t pivot = getRecord(buffer, left + (right - left) / 2);
             recordPtr start = copyPtr(left);
             recordPtr end = copyPtr(right);
             while (left <= right) {
-                while (compareRecords(getRecord(buffer, left), pivot, field) < 0) {
+                while (Key::compare(getRecord(buffer, left), pivot) < 0) {
                     incr(left);
                 }
-                while (compareRecords(getRecord(buffer, right), pivot, field) > 0) {
+                while (Key::compare(getRecord(buffer, right), pivot) > 0) {
                     decr(right);
                 }
                 if (left <= right) {
@@ -126,8 +132,8 @@ void introSort(block_t *buffer, recordPtr left, recordPtr right, unsigned char f
                 }
             }
             depth -= 1;
-            introSort(buffer, start, right, field, depth);
-            introSort(buffer, left, end, field, depth);
+            introSort<Key>(buffer, start, right, depth);
+            introSort<Key>(buffer, left, end, depth);
         }
 
     }
@@ -202,27 +208,54 @@ uint arrangeRecords(block_t* buffer, uint bufferSize, recordPtr &lastRecord) {
 // creates a sorted segment of records in buffer
 // returns false if the buffer has no valid records, true otherwise
 
-bool sortBuffer(block_t* buffer, uint bufferSize, unsigned char field) {
+template <class Key>
+bool sortBuffer(block_t* buffer, uint bufferSize) {
     // all the valid records of all tha valid blocks are gathered at the beginning
     // of the buffer and are then sorted using introsort. the remaining blocks
-    // are invalidated.
+    // are invalidated. records are gathered by their flags, so the flags of
+    // blocks in prefix form are written back first
+    syncFlags(buffer, bufferSize);
     recordPtr end;
     if (arrangeRecords(buffer, arrangeBlocks(buffer, bufferSize), end) == 0) {
         return false;
     }
-    introSort(buffer, newPtr(0), end, field, 2 * ((uint) floor(log2(end.block * MAX_RECORDS_PER_BLOCK + end.record + 1))));
+    introSort<Key>(buffer, newPtr(0), end, 2 * ((uint) floor(log2(end.block * MAX_RECORDS_PER_BLOCK + end.record + 1))));
     uint i = 0;
+    // the sorted segment is left in prefix form
     for (; i < end.block; i++) {
         buffer[i].nreserved = MAX_RECORDS_PER_BLOCK;
         buffer[i].blockid = i;
+        buffer[i].dummy = PREFIX_VALID;
     }
     buffer[end.block].nreserved = end.record + 1;
     buffer[end.block].blockid = i;
+    buffer[end.block].dummy = PREFIX_VALID;
 
     for (i += 1; i < bufferSize; i++) {
         buffer[i].valid = false;
         buffer[i].nreserved = 0;
         buffer[i].blockid = i;
+        buffer[i].dummy = PREFIX_VALID;
     }
     return true;
-}
\ No newline at end of file
+}
+
+template bool sortBuffer<RecidKey>(block_t* buffer, uint bufferSize);
+template bool sortBuffer<NumKey>(block_t* buffer, uint bufferSize);
+template bool sortBuffer<StrKey>(block_t* buffer, uint bufferSize);
+template bool sortBuffer<NumStrKey>(block_t* buffer, uint bufferSize);
+
+// sorts the buffer on field, dispatching to the specialised sort once
+
+bool sortBuffer(block_t* buffer, uint bufferSize, unsigned char field) {
+    switch (field) {
+        case 0:
+            return sortBuffer<RecidKey>(buffer, bufferSize);
+        case 1:
+            return sortBuffer<NumKey>(buffer, bufferSize);
+        case 2:
+            return sortBuffer<StrKey>(buffer, bufferSize);
+        default:
+            return sortBuffer<NumStrKey>(buffer, bufferSize);
+    }
+}
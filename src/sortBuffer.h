@@ -25,6 +25,16 @@
 #include <sys/types.h>
 
 #include "dbtproj.h"
+#include "recordOps.h"
+
+// sorts the records in the buffer on the field of the key policy
+template <class Key>
+bool sortBuffer(block_t* buffer, uint bufferSize);
+
+extern template bool sortBuffer<RecidKey>(block_t* buffer, uint bufferSize);
+extern template bool sortBuffer<NumKey>(block_t* buffer, uint bufferSize);
+extern template bool sortBuffer<StrKey>(block_t* buffer, uint bufferSize);
+extern template bool sortBuffer<NumStrKey>(block_t* buffer, uint bufferSize);
 
 // sorts the records in the buffer
 bool sortBuffer(block_t* buffer, uint bufferSize, unsigned char field);
@@ -0,0 +1,194 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include "strKernels.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define STR_X86
+#endif
+
+// crc32c (castagnoli) lookup table, used by the scalar hash
+
+static uint32_t crcTable[256];
+static bool crcTableBuilt = false;
+
+static void buildCrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+        }
+        crcTable[i] = crc;
+    }
+    crcTableBuilt = true;
+}
+
+// given 8 bytes of a string, clears its first '\0' and all the bytes after it,
+// so that the garbage after the end of a string is never hashed.
+// sets end to true if the string ends in these bytes
+
+static inline uint64_t maskWord(uint64_t word, bool &end) {
+    // the lowest byte flagged is always the first '\0'
+    uint64_t zero = (word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL;
+    if (zero == 0) {
+        return word;
+    }
+    end = true;
+    uint bits = __builtin_ctzll(zero) - 7;
+    if (bits == 0) {
+        return 0;
+    }
+    return word & ((1ULL << bits) - 1);
+}
+
+// scalar kernels
+
+static int compareScalar(const char *str1, const char *str2) {
+    return strcmp(str1, str2);
+}
+
+static uint hashScalar(const char *str) {
+    uint32_t crc = 0xFFFFFFFF;
+    bool end = false;
+    for (uint i = 0; i + 8 <= STR_LENGTH && !end; i += 8) {
+        uint64_t word;
+        memcpy(&word, str + i, 8);
+        word = maskWord(word, end);
+        for (int j = 0; j < 8; j++) {
+            crc = crcTable[(crc ^ word) & 0xFF] ^ (crc >> 8);
+            word >>= 8;
+        }
+    }
+    return ~crc;
+}
+
+#ifdef STR_X86
+
+// the vector kernels load the str field in fixed width chunks. the last chunk
+// is moved back so that it ends with the field, overlapping the previous one.
+// bytes already compared are equal and not '\0', so they cannot stop it.
+// the first byte that differs or is '\0' in str1 decides the result
+
+__attribute__((target("sse4.2")))
+static int compareSse42(const char *str1, const char *str2) {
+    const __m128i zero = _mm_setzero_si128();
+    for (uint i = 0; i < STR_LENGTH; i += 16) {
+        uint offset = i + 16 <= STR_LENGTH ? i : STR_LENGTH - 16;
+        __m128i a = _mm_loadu_si128((const __m128i*) (str1 + offset));
+        __m128i b = _mm_loadu_si128((const __m128i*) (str2 + offset));
+        uint stop = (~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xFFFF) | _mm_movemask_epi8(_mm_cmpeq_epi8(a, zero));
+        if (stop) {
+            uint j = offset + __builtin_ctz(stop);
+            return (unsigned char) str1[j] - (unsigned char) str2[j];
+        }
+    }
+    return 0;
+}
+
+__attribute__((target("avx2")))
+static int compareAvx2(const char *str1, const char *str2) {
+    const __m256i zero = _mm256_setzero_si256();
+    for (uint i = 0; i < STR_LENGTH; i += 32) {
+        uint offset = i + 32 <= STR_LENGTH ? i : STR_LENGTH - 32;
+        __m256i a = _mm256_loadu_si256((const __m256i*) (str1 + offset));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (str2 + offset));
+        uint stop = ~(uint) _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) | (uint) _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, zero));
+        if (stop) {
+            uint j = offset + __builtin_ctz(stop);
+            return (unsigned char) str1[j] - (unsigned char) str2[j];
+        }
+    }
+    return 0;
+}
+
+// same crc32c as hashScalar, 8 bytes per instruction
+
+__attribute__((target("sse4.2")))
+static uint hashSse42(const char *str) {
+    uint64_t crc = 0xFFFFFFFF;
+    bool end = false;
+    for (uint i = 0; i + 8 <= STR_LENGTH && !end; i += 8) {
+        uint64_t word;
+        memcpy(&word, str + i, 8);
+        crc = _mm_crc32_u64(crc, maskWord(word, end));
+    }
+    return ~(uint32_t) crc;
+}
+
+#endif
+
+// on first use, selects the best kernel and calls it
+
+static int compareResolve(const char *str1, const char *str2) {
+    setStrKernel(bestStrKernel());
+    return compareStr(str1, str2);
+}
+
+static uint hashResolve(const char *str) {
+    setStrKernel(bestStrKernel());
+    return hashStr(str);
+}
+
+int (*compareStr)(const char *str1, const char *str2) = compareResolve;
+uint (*hashStr)(const char *str) = hashResolve;
+
+strKernel bestStrKernel() {
+#ifdef STR_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        if (__builtin_cpu_supports("avx2")) {
+            return STR_AVX2;
+        }
+        return STR_SSE42;
+    }
+#endif
+    return STR_SCALAR;
+}
+
+strKernel setStrKernel(strKernel kernel) {
+    strKernel best = bestStrKernel();
+    if (kernel > best) {
+        kernel = best;
+    }
+    switch (kernel) {
+#ifdef STR_X86
+        case STR_AVX2:
+            compareStr = compareAvx2;
+            hashStr = hashSse42;
+            break;
+        case STR_SSE42:
+            compareStr = compareSse42;
+            hashStr = hashSse42;
+            break;
+#endif
+        default:
+            if (!crcTableBuilt) {
+                buildCrcTable();
+            }
+            compareStr = compareScalar;
+            hashStr = hashScalar;
+    }
+    return kernel;
+}
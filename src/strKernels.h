@@ -0,0 +1,59 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef STRKERNELS_H
+#define	STRKERNELS_H
+
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// kernels used to compare and hash the str field of records
+// STR_SCALAR: strcmp and a table driven crc32c, for any cpu
+// STR_SSE42: 16 byte compares and the crc32 instruction
+// STR_AVX2: 32 byte compares and the crc32 instruction
+// all the kernels give the same results, they only differ in speed
+
+enum strKernel {
+    STR_SCALAR,
+    STR_SSE42,
+    STR_AVX2
+};
+
+// the kernels read the whole STR_LENGTH bytes of str in fixed width loads and
+// stop at the first difference or '\0', so the tail after '\0' is never used.
+// they must only be given the str field of a record, not arbitrary strings
+
+// returns the fastest kernel the cpu supports, as reported by cpuid
+strKernel bestStrKernel();
+
+// sets the kernel used from now on and returns it. if the cpu does not
+// support the kernel asked for, the best one it supports is used instead.
+// by default the best kernel is selected on first use
+strKernel setStrKernel(strKernel kernel);
+
+// compares the str fields of 2 records like strcmp does
+extern int (*compareStr)(const char *str1, const char *str2);
+
+// hashes the str field of a record
+extern uint (*hashStr)(const char *str);
+
+#endif
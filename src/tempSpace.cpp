@@ -0,0 +1,109 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#include "tempSpace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+// the most temp directories that can be set
+#define MAX_TEMP_DIRS 16
+
+// the temp directories set, or none for the current directory
+static char *tempDirs[MAX_TEMP_DIRS];
+static uint ntempDirs = 0;
+// the number of workspaces opened so far, which picks the directory of the next
+static uint nspaces = 0;
+
+void setTempDirs(const char *dirs) {
+    for (uint i = 0; i < ntempDirs; i++) {
+        free(tempDirs[i]);
+    }
+    ntempDirs = 0;
+    const char *start = dirs;
+    while (ntempDirs < MAX_TEMP_DIRS) {
+        const char *end = strchr(start, ':');
+        size_t length = end ? (size_t) (end - start) : strlen(start);
+        if (length != 0) {
+            tempDirs[ntempDirs] = strndup(start, length);
+            ntempDirs += 1;
+        }
+        if (!end) {
+            break;
+        }
+        start = end + 1;
+    }
+}
+
+bool openSpace(tempSpace &space) {
+    const char *dir = ".";
+    if (ntempDirs != 0) {
+        dir = tempDirs[__atomic_fetch_add(&nspaces, 1, __ATOMIC_RELAXED) % ntempDirs];
+    }
+    space.path = (char*) malloc(strlen(dir) + 16);
+    sprintf(space.path, "%s/.dbt_XXXXXX", dir);
+    if (!mkdtemp(space.path)) {
+        printf("Cannot create a temp workspace in %s.", dir);
+        free(space.path);
+        space.path = NULL;
+        return false;
+    }
+    return true;
+}
+
+char *tempPath(tempSpace &space, const char *name) {
+    char *path = (char*) malloc(strlen(space.path) + strlen(name) + 2);
+    sprintf(path, "%s/%s", space.path, name);
+    return path;
+}
+
+const char *spaceName(tempSpace &space, const char *path) {
+    size_t length = strlen(space.path);
+    if (strncmp(path, space.path, length) == 0 && path[length] == '/') {
+        return path + length + 1;
+    }
+    return path;
+}
+
+void closeSpace(tempSpace &space) {
+    if (!space.path) {
+        return;
+    }
+    DIR *dir = opendir(space.path);
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            char *path = tempPath(space, entry->d_name);
+            unlink(path);
+            free(path);
+        }
+        closedir(dir);
+    }
+    rmdir(space.path);
+    free(space.path);
+    space.path = NULL;
+}
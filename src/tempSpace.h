@@ -0,0 +1,59 @@
+/*
+* DBMS Implementation
+* Copyright (C) 2013 George Piskas, George Economides
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*
+* Contact: geopiskas@gmail.com
+*/
+
+#ifndef TEMPSPACE_H
+#define	TEMPSPACE_H
+
+#include <sys/types.h>
+
+#include "dbtproj.h"
+
+// the temp files of an operator are kept in a workspace: a directory of its
+// own, created with a unique name under one of the temp directories. operators
+// running at the same time, in one process or in many, never share a temp
+// file, and whatever is left in a workspace is removed with it
+
+typedef struct {
+    char *path;
+} tempSpace;
+
+// sets the directories the workspaces are created in, separated by ':'. the
+// workspaces are spread over them in turn, eg over different disks. the
+// default is the current directory. it should be set before operators run
+void setTempDirs(const char *dirs);
+
+// creates a workspace. returns false, with an error printed, if it cannot be
+// created
+bool openSpace(tempSpace &space);
+
+// returns the path of the file named name in the workspace. it is allocated
+// with malloc and should be freed
+char *tempPath(tempSpace &space, const char *name);
+
+// returns the name of path in the workspace if path is a file of it, otherwise
+// path itself. the name of the workspace is random, so whatever is derived
+// from the name of a temp file, eg a hash seed, should use this instead
+const char *spaceName(tempSpace &space, const char *path);
+
+// removes the files left in the workspace and the workspace itself
+void closeSpace(tempSpace &space);
+
+#endif